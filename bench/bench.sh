@@ -140,7 +140,7 @@ if [[ ! -z "${DATA_WORD_COUNT}" ]]; then
   echo -n ","
   echo -n $(${CPP} -std=c++17 -O3 ${BENCH_DIR}/word_count/word_count.cpp && ./a.out $DATA_WORD_COUNT | tail -n 1)
   echo -n ","
-  echo -n $(${CODON} run -release ${BENCH_DIR}/word_count/word_count.py $DATA_WORD_COUNT | tail -n 1)
+  echo -n $(${CODON} run -release ${BENCH_DIR}/word_count/word_count.codon $DATA_WORD_COUNT | tail -n 1)
   echo ""
 fi
 
@@ -169,3 +169,159 @@ echo -n ","
 echo -n ","
 echo -n $(${CODON} run -release ${BENCH_DIR}/mandelbrot/mandelbrot.codon | tail -n 1)
 echo ""
+
+# EXPR_TREE
+echo -n "expr_tree"
+echo -n ","
+echo -n $(${PYTHON} ${BENCH_DIR}/expr_tree/expr_tree.py | tail -n 1)
+echo -n ","
+echo -n $(${PYPY} ${BENCH_DIR}/expr_tree/expr_tree.py | tail -n 1)
+echo -n ","
+# nothing for cpp
+echo -n ","
+echo -n $(${CODON} run -release ${BENCH_DIR}/expr_tree/expr_tree.codon | tail -n 1)
+echo ""
+
+# REDUCTIONS
+echo -n "reductions"
+echo -n ","
+echo -n $(${PYTHON} ${BENCH_DIR}/reductions/reductions.py 200 | tail -n 1)
+echo -n ","
+echo -n $(${PYPY} ${BENCH_DIR}/reductions/reductions.py 200 | tail -n 1)
+echo -n ","
+# nothing for cpp
+echo -n ","
+echo -n $(${CODON} run -release ${BENCH_DIR}/reductions/reductions.codon 200 | tail -n 1)
+echo ""
+
+# WORK STEALING
+echo -n "work_stealing"
+echo -n ","
+echo -n $(${PYTHON} ${BENCH_DIR}/work_stealing/work_stealing.py 16 30 | tail -n 1)
+echo -n ","
+echo -n $(${PYPY} ${BENCH_DIR}/work_stealing/work_stealing.py 16 30 | tail -n 1)
+echo -n ","
+# nothing for cpp
+echo -n ","
+echo -n $(${CODON} run -release ${BENCH_DIR}/work_stealing/work_stealing.codon 16 30 | tail -n 1)
+echo ""
+
+# PIPELINE STAGES
+echo -n "pipeline_stages"
+echo -n ","
+echo -n $(${PYTHON} ${BENCH_DIR}/pipeline_stages/pipeline_stages.py 100000 | tail -n 1)
+echo -n ","
+echo -n $(${PYPY} ${BENCH_DIR}/pipeline_stages/pipeline_stages.py 100000 | tail -n 1)
+echo -n ","
+# nothing for cpp
+echo -n ","
+echo -n $(${CODON} run -release -par-pipeline-stages -par-pipeline-workers=4 ${BENCH_DIR}/pipeline_stages/pipeline_stages.codon 100000 | tail -n 1)
+echo ""
+
+# SORT KEY
+echo -n "sort_key"
+echo -n ","
+echo -n $(${PYTHON} ${BENCH_DIR}/sort_key/sort_key.py 1000000 | tail -n 1)
+echo -n ","
+echo -n $(${PYPY} ${BENCH_DIR}/sort_key/sort_key.py 1000000 | tail -n 1)
+echo -n ","
+# nothing for cpp
+echo -n ","
+echo -n $(${CODON} run -release ${BENCH_DIR}/sort_key/sort_key.codon 1000000 | tail -n 1)
+echo ""
+
+# DICT PROBE
+echo -n "dict_probe"
+echo -n ","
+echo -n $(${PYTHON} ${BENCH_DIR}/dict_probe/dict_probe.py 1000000 | tail -n 1)
+echo -n ","
+echo -n $(${PYPY} ${BENCH_DIR}/dict_probe/dict_probe.py 1000000 | tail -n 1)
+echo -n ","
+# nothing for cpp
+echo -n ","
+echo -n $(${CODON} run -release ${BENCH_DIR}/dict_probe/dict_probe.codon 1000000 | tail -n 1)
+echo ""
+
+# DICT PROBE, KHASH BASELINE
+echo -n "dict_probe_khash"
+echo -n ","
+# nothing for python
+echo -n ","
+# nothing for pypy
+echo -n ","
+# nothing for cpp
+echo -n ","
+echo -n $(${CODON} run -release ${BENCH_DIR}/dict_probe/dict_probe.codon 1000000 khash | tail -n 1)
+echo ""
+
+# GC TYPED
+echo -n "gc_typed"
+echo -n ","
+echo -n $(${PYTHON} ${BENCH_DIR}/gc_typed/gc_typed.py 2000000 | tail -n 1)
+echo -n ","
+echo -n $(${PYPY} ${BENCH_DIR}/gc_typed/gc_typed.py 2000000 | tail -n 1)
+echo -n ","
+# nothing for cpp
+echo -n ","
+echo -n $(${CODON} run -release ${BENCH_DIR}/gc_typed/gc_typed.codon 2000000 | tail -n 1)
+echo ""
+
+# PAR ALLOC
+echo -n "par_alloc"
+echo -n ","
+echo -n $(${PYTHON} ${BENCH_DIR}/par_alloc/par_alloc.py 200000 | tail -n 1)
+echo -n ","
+echo -n $(${PYPY} ${BENCH_DIR}/par_alloc/par_alloc.py 200000 | tail -n 1)
+echo -n ","
+# nothing for cpp
+echo -n ","
+echo -n $(${CODON} run -release ${BENCH_DIR}/par_alloc/par_alloc.codon 200000 | tail -n 1)
+echo ""
+
+# EXC FLOW
+echo -n "exc_flow"
+echo -n ","
+echo -n $(${PYTHON} ${BENCH_DIR}/exc_flow/exc_flow.py 2000000 | tail -n 1)
+echo -n ","
+echo -n $(${PYPY} ${BENCH_DIR}/exc_flow/exc_flow.py 2000000 | tail -n 1)
+echo -n ","
+# nothing for cpp
+echo -n ","
+echo -n $(${CODON} run -release ${BENCH_DIR}/exc_flow/exc_flow.codon 2000000 | tail -n 1)
+echo ""
+
+# LOCK CONTENTION
+echo -n "lock_contention"
+echo -n ","
+echo -n $(${PYTHON} ${BENCH_DIR}/lock_contention/lock_contention.py 10000000 | tail -n 1)
+echo -n ","
+echo -n $(${PYPY} ${BENCH_DIR}/lock_contention/lock_contention.py 10000000 | tail -n 1)
+echo -n ","
+# nothing for cpp
+echo -n ","
+echo -n $(${CODON} run -release ${BENCH_DIR}/lock_contention/lock_contention.codon 10000000 | tail -n 1)
+echo ""
+
+# TASK POOL
+echo -n "task_pool"
+echo -n ","
+echo -n $(${PYTHON} ${BENCH_DIR}/task_pool/task_pool.py 200000 | tail -n 1)
+echo -n ","
+echo -n $(${PYPY} ${BENCH_DIR}/task_pool/task_pool.py 200000 | tail -n 1)
+echo -n ","
+# nothing for cpp
+echo -n ","
+echo -n $(${CODON} run -release ${BENCH_DIR}/task_pool/task_pool.codon 200000 | tail -n 1)
+echo ""
+
+# LOG CLASSIFY
+echo -n "log_classify"
+echo -n ","
+echo -n $(${PYTHON} ${BENCH_DIR}/log_classify/log_classify.py 100000 | tail -n 1)
+echo -n ","
+echo -n $(${PYPY} ${BENCH_DIR}/log_classify/log_classify.py 100000 | tail -n 1)
+echo -n ","
+# nothing for cpp
+echo -n ","
+echo -n $(${CODON} run -release ${BENCH_DIR}/log_classify/log_classify.codon 100000 | tail -n 1)
+echo ""
@@ -0,0 +1,59 @@
+from sys import argv
+from time import time
+
+# inserts, hits, misses, deletes, iteration and copies on int and str keys,
+# for table sizes from a few groups up to well past the last-level cache
+n = int(argv[1]) if len(argv) > 1 else 100000000
+
+def bench(keys, absent, label):
+    m = len(keys)
+    t = time()
+    d = {}
+    for i in range(m):
+        d[keys[i]] = i
+    t_ins = time() - t
+
+    t = time()
+    hits = 0
+    for k in keys:
+        hits += d[k]
+    t_hit = time() - t
+
+    t = time()
+    misses = 0
+    for k in absent:
+        if k in d:
+            misses += 1
+    t_miss = time() - t
+
+    t = time()
+    for i in range(0, m, 2):
+        del d[keys[i]]
+    t_del = time() - t
+
+    # the table now holds half as many entries as it has room for
+    t = time()
+    total = 0
+    for _ in range(10):
+        for v in d.values():
+            total += v
+    t_iter = time() - t
+
+    t = time()
+    e = d.copy()
+    t_copy = time() - t
+
+    print(f'{label} n={m}: insert {t_ins:.3f}s, hit {t_hit:.3f}s, '
+          f'miss {t_miss:.3f}s, delete {t_del:.3f}s, iterate {t_iter:.3f}s, '
+          f'copy {t_copy:.3f}s', hits, misses, total, len(e))
+
+t0 = time()
+size = 10
+while size <= n:
+    ints = [i * 2654435761 % (1 << 40) for i in range(size)]
+    absent = [-k - 1 for k in ints]
+    bench(ints, absent, 'int')
+    bench([f'key{k}' for k in ints], [f'key{k}' for k in absent], 'str')
+    size *= 10
+t1 = time()
+print(t1 - t0)
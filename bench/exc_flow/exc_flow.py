@@ -0,0 +1,48 @@
+from sys import argv
+from time import time
+
+def lookups(d, n):
+    hits = 0
+    for i in range(n):
+        k = i % 1000
+        try:
+            v = d[k]
+        except KeyError:
+            v = 0
+        hits += v
+    return hits
+
+def parse(words):
+    total = 0
+    for w in words:
+        try:
+            total += int(w)
+        except ValueError:
+            total -= 1
+    return total
+
+def check(i):
+    if i % 3 == 0:
+        raise IndexError("bad index")
+    return i
+
+def raises(n):
+    caught = 0
+    for i in range(n):
+        try:
+            check(i)
+        except IndexError:
+            caught += 1
+    return caught
+
+n = int(argv[1]) if len(argv) > 1 else 2000000
+
+d = {i: i for i in range(0, 1000, 10)}  # 90% misses
+words = [str(i) if i % 2 else 'x' + str(i) for i in range(n)]
+
+t0 = time()
+print(lookups(d, n))
+print(parse(words))
+print(raises(n))
+t1 = time()
+print(t1 - t0)
@@ -0,0 +1,70 @@
+# Evaluates randomly generated arithmetic expression trees
+# built from a small class hierarchy. Nearly all of the time
+# is spent in virtual method calls.
+import random
+from sys import argv
+from time import time
+
+class Expr:
+    def eval(self, x):
+        return 0.0
+
+    def size(self):
+        return 1
+
+class Leaf(Expr):
+    def __init__(self, value, is_var):
+        self.value = value
+        self.is_var = is_var
+
+    def eval(self, x):
+        return x if self.is_var else self.value
+
+class Add(Expr):
+    def __init__(self, lhs, rhs):
+        self.lhs = lhs
+        self.rhs = rhs
+
+    def eval(self, x):
+        return self.lhs.eval(x) + self.rhs.eval(x)
+
+    def size(self):
+        return 1 + self.lhs.size() + self.rhs.size()
+
+class Mul(Expr):
+    def __init__(self, lhs, rhs):
+        self.lhs = lhs
+        self.rhs = rhs
+
+    def eval(self, x):
+        return self.lhs.eval(x) * self.rhs.eval(x)
+
+    def size(self):
+        return 1 + self.lhs.size() + self.rhs.size()
+
+def build(depth):
+    if depth == 0:
+        return Leaf(random.random(), random.random() < 0.5)
+    if random.random() < 0.5:
+        return Add(build(depth - 1), build(depth - 1))
+    else:
+        return Mul(build(depth - 1), build(depth - 1))
+
+n = int(argv[1]) if len(argv) > 1 else 200
+random.seed(42)
+
+t0 = time()
+trees = [build(12) for _ in range(16)]
+nodes = 0
+for tree in trees:
+    nodes += tree.size()
+
+total = 0.0
+for i in range(n):
+    x = i / n
+    for tree in trees:
+        total += tree.eval(x)
+t1 = time()
+
+print(nodes, total)
+print(t1 - t0)
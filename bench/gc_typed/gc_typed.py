@@ -0,0 +1,64 @@
+from sys import argv
+from time import time
+import gc
+
+# full collections over a heap of pointer-heavy records: a list of
+# (int, str, float) tuples and objects with many numeric fields
+n = int(argv[1]) if len(argv) > 1 else 2000000
+
+class Particle:
+    x: float
+    y: float
+    z: float
+    vx: float
+    vy: float
+    vz: float
+    ax: float
+    ay: float
+    az: float
+    mass: float
+    charge: float
+    spin: float
+    age: int
+    kind: int
+    flags: int
+    seed: int
+    hist0: float
+    hist1: float
+    hist2: float
+    hist3: float
+    hist4: float
+    hist5: float
+    hist6: float
+    hist7: float
+    hist8: float
+    hist9: float
+    hist10: float
+    hist11: float
+    hist12: float
+    hist13: float
+    hist14: float
+    hist15: float
+    label: str
+
+    def __init__(self, i: int):
+        self.x = float(i)
+        self.mass = 1.0
+        self.kind = i % 7
+        self.label = str(i)
+
+rows = [(i, str(i), i * 0.5) for i in range(n)]
+particles = [Particle(i) for i in range(n // 4)]
+
+t = time()
+for _ in range(10):
+    gc.collect()
+t_gc = time() - t
+
+total = 0
+for r in rows:
+    total += r[0]
+for p in particles:
+    total += p.kind
+print(total)
+print(t_gc)
@@ -0,0 +1,25 @@
+from sys import argv
+from time import time
+from threading import Lock
+
+def locked(n):
+    lock = Lock()
+    total = 0
+    for i in range(n):
+        with lock:
+            total += i
+    return total
+
+def counted(n):
+    count = 0
+    for i in range(n):
+        count += 1
+    return count
+
+n = int(argv[1]) if len(argv) > 1 else 10000000
+
+t0 = time()
+print(locked(n))
+print(counted(n))
+t1 = time()
+print(t1 - t0)
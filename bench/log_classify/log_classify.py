@@ -0,0 +1,47 @@
+from sys import argv
+from time import time
+import re
+
+LEVELS = ['INFO', 'DEBUG', 'WARN', 'ERROR']
+WORDS = ['request', 'user', 'cache', 'disk', 'connection', 'query', 'token',
+         'session', 'worker', 'retry', 'upstream', 'socket']
+
+# 40 classifier patterns
+PATTERNS = ([r'\b' + w + r'\b.*\b(failed|refused|reset)\b' for w in WORDS] +
+            [r'^' + lvl + r' ' for lvl in LEVELS] +
+            [r'status=5\d\d', r'status=4\d\d', r'latency=\d{4,}ms',
+             r'user=[a-z]+\d{3}', r'/api/v\d+/', r'timeout after \d+s',
+             r'[0-9a-f]{32}', r'\b(GET|POST|PUT|DELETE) /', r'out of memory',
+             r'panic:', r'disk \d+% full', r'retry #\d+', r'\bssl\b',
+             r'session [0-9a-f]{8} expired', r'slow query', r'deadlock',
+             r'connection pool exhausted', r'rate limit', r'invalid token',
+             r'worker \d+ (started|stopped)', r'cache (hit|miss)',
+             r'upstream \w+ unavailable', r'socket closed', r'ip=10\.\d+'])
+
+def make_lines(n):
+    lines = []
+    x = 12345
+    for i in range(n):
+        x = (x * 1103515245 + 12345) % 2147483648
+        lvl = LEVELS[x % 4]
+        w = WORDS[(x >> 3) % len(WORDS)]
+        status = 200 + (x >> 7) % 400
+        latency = (x >> 11) % 3000
+        verb = ['failed', 'ok', 'refused', 'done'][(x >> 13) % 4]
+        lines.append(f'{lvl} {w} {verb} status={status} latency={latency}ms '
+                     f'user=u{(x >> 17) % 1000:03d} retry #{(x >> 5) % 5}')
+    return lines
+
+n = int(argv[1]) if len(argv) > 1 else 100000
+lines = make_lines(n)
+
+t0 = time()
+pats = [re.compile(p) for p in PATTERNS]
+counts = [0] * len(PATTERNS)
+for line in lines:
+    for i, p in enumerate(pats):
+        if p.search(line):
+            counts[i] += 1
+print(sum(counts))
+t1 = time()
+print(t1 - t0)
@@ -0,0 +1,30 @@
+from sys import argv
+from time import time
+
+class Node:
+    def __init__(self, key, value, next):
+        self.key = key
+        self.value = value
+        self.next = next
+
+def run(n):
+    total = 0
+    for i in range(n):
+        head = None
+        for j in range(8):
+            head = Node(j, float(i), head)
+        m = 40 + i % 200
+        buf = []
+        for j in range(m):
+            buf.append(head)
+        total += len(buf) + head.key
+    return total
+
+n = int(argv[1]) if len(argv) > 1 else 2000000
+
+t0 = time()
+total = run(n)
+t1 = time()
+
+print(total)
+print(t1 - t0)
@@ -0,0 +1,42 @@
+from sys import argv
+from time import time
+
+# I/O-bound source stage followed by a compute-bound stage.
+
+def write_input(path, n):
+    with open(path, 'w') as f:
+        for i in range(n):
+            f.write(f'{i},{(i * 7919) % 10007},{(i * 104729) % 1009}\n')
+
+def read_lines(path):
+    with open(path) as f:
+        for line in f:
+            yield line
+
+def parse(line):
+    a, b, c = line.split(',')
+    return int(a), int(b), int(c)
+
+def work(rec):
+    a, b, c = rec
+    x = a
+    for _ in range(200):
+        x = (x * b + c) % 1000003
+    return x
+
+total = [0]
+
+def accumulate(x):
+    total[0] += x
+
+n = int(argv[1]) if len(argv) > 1 else 1000000
+path = argv[2] if len(argv) > 2 else '/tmp/codon_pipeline_stages.txt'
+write_input(path, n)
+
+t0 = time()
+for line in read_lines(path):
+    accumulate(work(parse(line)))
+t1 = time()
+
+print(total[0])
+print(t1 - t0)
@@ -0,0 +1,26 @@
+from sys import argv
+from time import time
+
+def run(regions, n):
+    s = 0.
+    m = 0.
+    p = 1.
+    sc = (0., 0)
+    for r in range(regions):
+        for i in range(n):
+            x = float((i * 7 + r) % 1000) / 1000.
+            s += x
+            m = max(m, x)
+            p *= 1. + x * 1e-9
+            sc = (sc[0] + x, sc[1] + 1)
+    return s, m, p, sc
+
+regions = int(argv[1]) if len(argv) > 1 else 2000
+n = int(argv[2]) if len(argv) > 2 else 10000
+
+t0 = time()
+s, m, p, sc = run(regions, n)
+t1 = time()
+
+print(s, m, p, sc[1])
+print(t1 - t0)
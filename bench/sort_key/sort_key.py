@@ -0,0 +1,14 @@
+from sys import argv
+from time import time
+import random
+
+n = int(argv[1]) if len(argv) > 1 else 1000000
+random.seed(0)
+names = [f'Name{random.randint(0, n)}' for _ in range(n)]
+
+t0 = time()
+v = sorted(names, key=lambda s: s.lower())
+t1 = time()
+
+print(v[0], v[-1])
+print(t1 - t0)
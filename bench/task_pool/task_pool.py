@@ -0,0 +1,29 @@
+from sys import argv
+from time import time
+from concurrent.futures import ThreadPoolExecutor, as_completed
+
+def work(i):
+    x = i
+    for _ in range(100):
+        x = (x * 1103515245 + 12345) % 2147483648
+    return x
+
+def fib(ex, n):
+    if n < 20:
+        return fib_seq(n)
+    f = ex.submit(fib, ex, n - 1)
+    return fib_seq(n - 2) + f.result()
+
+def fib_seq(n):
+    return n if n < 2 else fib_seq(n - 1) + fib_seq(n - 2)
+
+n = int(argv[1]) if len(argv) > 1 else 200000
+
+t0 = time()
+with ThreadPoolExecutor(max_workers=8) as ex:
+    print(sum(f.result() for f in [ex.submit(work, i) for i in range(n)]))
+    print(sum(f.result() for f in as_completed([ex.submit(work, i) for i in range(n)])))
+    print(sum(ex.map(work, range(n))))
+    print(fib(ex, 26))
+t1 = time()
+print(t1 - t0)
@@ -0,0 +1,42 @@
+from sys import argv
+from time import time
+
+class Node:
+    def __init__(self, left=None, right=None):
+        self.left = left
+        self.right = right
+
+def make_tree(d):
+    return Node(make_tree(d - 1), make_tree(d - 1)) if d > 0 else Node()
+
+def check_tree(node):
+    l, r = node.left, node.right
+    if l is None:
+        return 1
+    else:
+        return 1 + check_tree(l) + check_tree(r)
+
+def trees(n, min_depth=4):
+    max_depth = max(min_depth + 2, n)
+    cs = 0
+    for d in range(min_depth, max_depth + 1, 2):
+        for i in range(2 ** (max_depth + min_depth - d)):
+            cs += check_tree(make_tree(d))
+    return cs
+
+def fib(n):
+    return n if n < 2 else fib(n - 1) + fib(n - 2)
+
+depth = int(argv[1]) if len(argv) > 1 else 18
+n = int(argv[2]) if len(argv) > 2 else 38
+
+t0 = time()
+t = time()
+cs = trees(depth)
+print(f'binary trees: {time() - t:.3f}s', cs)
+t = time()
+r = fib(n)
+print(f'fib: {time() - t:.3f}s', r)
+t1 = time()
+
+print(t1 - t0)
@@ -11,6 +11,12 @@
 #include <unordered_map>
 #include <vector>
 
+#include "codon/cir/analyze/dataflow/cfg.h"
+#include "codon/cir/analyze/module/global_vars.h"
+#include "codon/cir/analyze/module/side_effect.h"
+#include "codon/cir/transform/lowering/pipeline.h"
+#include "codon/cir/transform/parallel/autopar.h"
+#include "codon/cir/transform/parallel/openmp.h"
 #include "codon/compiler/compiler.h"
 #include "codon/compiler/error.h"
 #include "codon/compiler/jit.h"
@@ -89,6 +95,7 @@ void initLogFlags(const llvm::cl::opt<std::string> &log) {
 enum BuildKind { LLVM, Bitcode, Object, Executable, Library, PyExtension, Detect };
 enum OptMode { Debug, Release };
 enum Numerics { C, Python };
+enum ParRuntime { OpenMP, WorkStealing };
 } // namespace
 
 int docMode(const std::vector<const char *> &args, const std::string &argv0) {
@@ -142,6 +149,43 @@ std::unique_ptr<codon::Compiler> processSource(
                      "Python semantics: mirrors Python but might disable optimizations "
                      "like vectorization")),
       llvm::cl::init(C));
+  llvm::cl::opt<bool> autoPar(
+      "auto-par",
+      llvm::cl::desc("Automatically parallelize loops with independent iterations "
+                     "and print a report of the loops considered"));
+  llvm::cl::opt<ParRuntime> parRuntime(
+      "par-runtime", llvm::cl::desc("default runtime for parallel loops"),
+      llvm::cl::values(
+          clEnumValN(OpenMP, "omp", "OpenMP runtime"),
+          clEnumValN(WorkStealing, "ws",
+                     "Work-stealing runtime: better suited to nested and recursive "
+                     "parallelism")),
+      llvm::cl::init(OpenMP));
+  llvm::cl::opt<int> parPipelineChunk(
+      "par-pipeline-chunk",
+      llvm::cl::desc("number of items per task in parallel pipeline (||>) stages"),
+      llvm::cl::init(1));
+  llvm::cl::opt<bool> parPipelineKeepOrder(
+      "par-pipeline-keep-order",
+      llvm::cl::desc("keep item order in lists built up by parallel pipeline stages"));
+  llvm::cl::opt<bool> parPipelineStages(
+      "par-pipeline-stages",
+      llvm::cl::desc("run the stages between parallel pipes (||>) on their own "
+                     "threads, connected by bounded queues"));
+  llvm::cl::opt<int> parPipelineWorkers(
+      "par-pipeline-workers",
+      llvm::cl::desc("number of threads per pipeline stage group with "
+                     "-par-pipeline-stages"),
+      llvm::cl::init(1));
+  llvm::cl::opt<int> parPipelineQueue(
+      "par-pipeline-queue",
+      llvm::cl::desc("capacity of the queues between pipeline stage groups with "
+                     "-par-pipeline-stages"),
+      llvm::cl::init(1024));
+  llvm::cl::opt<bool> allocProfile(
+      "alloc-profile",
+      llvm::cl::desc("sample allocations and write a pprof heap profile at exit to "
+                     "the file named by CODON_ALLOC_PROFILE"));
 
   llvm::cl::ParseCommandLineOptions(args.size(), args.data());
   initLogFlags(log);
@@ -171,6 +215,37 @@ std::unique_ptr<codon::Compiler> processSource(
       args[0], isDebug, disabledOptsVec,
       /*isTest=*/false, (numerics == Numerics::Python), pyExtension());
   compiler->getLLVMVisitor()->setStandalone(standalone);
+  compiler->getLLVMVisitor()->setAllocProfile(allocProfile);
+
+  if (parRuntime == WorkStealing) {
+    using namespace codon::ir::transform::parallel;
+    if (auto *pass = compiler->getPassManager()->getPass(OpenMPPass::KEY))
+      static_cast<OpenMPPass *>(pass)->setWorkStealing(true);
+  }
+
+  if (auto *pass = compiler->getPassManager()->getPass(
+          codon::ir::transform::lowering::PipelineLowering::KEY)) {
+    using namespace codon::ir::transform::lowering;
+    auto *lowering = static_cast<PipelineLowering *>(pass);
+    lowering->setParallelSchedule(parPipelineChunk, parPipelineKeepOrder);
+    if (parPipelineStages)
+      lowering->setStaged(std::max(1, parPipelineWorkers.getValue()),
+                          std::max(2, parPipelineQueue.getValue()));
+  }
+
+  if (autoPar) {
+    if (isDebug) {
+      codon::compilationWarning("-auto-par has no effect without -release");
+    } else {
+      using namespace codon::ir;
+      compiler->getPassManager()->registerPass(
+          std::make_unique<transform::parallel::AutoParallelizationPass>(
+              analyze::module::SideEffectAnalysis::KEY),
+          /*insertBefore=*/transform::parallel::OpenMPPass::KEY,
+          {analyze::module::SideEffectAnalysis::KEY},
+          {analyze::dataflow::CFAnalysis::KEY, analyze::module::GlobalVarsAnalyses::KEY});
+    }
+  }
 
   // load plugins
   for (const auto &plugin : plugins) {
@@ -43,6 +43,14 @@ const std::string SrcInfoAttribute::AttributeName = "srcInfoAttribute";
 
 const std::string DocstringAttribute::AttributeName = "docstringAttribute";
 
+const std::string VectorizeAttribute::AttributeName = "vectorizeAttribute";
+
+std::ostream &VectorizeAttribute::doFormat(std::ostream &os) const {
+  fmt::print(os, FMT_STRING("(width={},interleave={},safelen={})"), width, interleave,
+             safelen);
+  return os;
+}
+
 const std::string TupleLiteralAttribute::AttributeName = "tupleLiteralAttribute";
 
 std::unique_ptr<Attribute> TupleLiteralAttribute::clone(util::CloneVisitor &cv) const {
@@ -135,6 +135,36 @@ private:
   std::ostream &doFormat(std::ostream &os) const override;
 };
 
+/// Attribute attached to loops carrying vectorization hints
+struct VectorizeAttribute : public Attribute {
+  static const std::string AttributeName;
+
+  /// vector width, or 0 to let the vectorizer choose
+  int64_t width;
+  /// interleave count, or 0 to let the vectorizer choose
+  int64_t interleave;
+  /// maximum distance between iterations that may run concurrently,
+  /// or 0 if iterations have no dependences at all
+  int64_t safelen;
+  /// location of the annotated loop, if the hints were moved to another one
+  codon::SrcInfo loc;
+
+  /// Constructs a VectorizeAttribute.
+  /// @param width the vector width
+  /// @param interleave the interleave count
+  /// @param safelen the safe iteration distance
+  explicit VectorizeAttribute(int64_t width = 0, int64_t interleave = 0,
+                              int64_t safelen = 0)
+      : width(width), interleave(interleave), safelen(safelen), loc() {}
+
+  std::unique_ptr<Attribute> clone(util::CloneVisitor &cv) const override {
+    return std::make_unique<VectorizeAttribute>(*this);
+  }
+
+private:
+  std::ostream &doFormat(std::ostream &os) const override;
+};
+
 /// Attribute attached to IR structures corresponding to tuple literals
 struct TupleLiteralAttribute : public Attribute {
   static const std::string AttributeName;
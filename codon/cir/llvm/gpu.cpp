@@ -331,6 +331,7 @@ void remapFunctions(llvm::Module *M) {
       // runtime library functions
       {"seq_free", "free"},
       {"seq_register_finalizer", ""},
+      {"seq_free_exc", ""},
       {"seq_gc_add_roots", ""},
       {"seq_gc_remove_roots", ""},
       {"seq_gc_clear_roots", ""},
@@ -353,6 +354,13 @@ void remapFunctions(llvm::Module *M) {
          B.CreateRet(mem);
        }},
 
+      {"seq_alloc_typed",
+       [](llvm::IRBuilder<> &B, const std::vector<llvm::Value *> &args) {
+         auto *M = B.GetInsertBlock()->getModule();
+         llvm::Value *mem = B.CreateCall(makeMalloc(M), args[0]);
+         B.CreateRet(mem);
+       }},
+
       {"seq_realloc",
        [](llvm::IRBuilder<> &B, const std::vector<llvm::Value *> &args) {
          auto *M = B.GetInsertBlock()->getModule();
@@ -364,6 +372,17 @@ void remapFunctions(llvm::Module *M) {
          B.CreateRet(mem);
        }},
 
+      {"seq_realloc_typed",
+       [](llvm::IRBuilder<> &B, const std::vector<llvm::Value *> &args) {
+         auto *M = B.GetInsertBlock()->getModule();
+         llvm::Value *mem = B.CreateCall(makeMalloc(M), args[1]);
+         auto F = llvm::Intrinsic::getDeclaration(
+             M, llvm::Intrinsic::memcpy,
+             {B.getInt8PtrTy(), B.getInt8PtrTy(), B.getInt64Ty()});
+         B.CreateCall(F, {mem, args[0], args[2], B.getFalse()});
+         B.CreateRet(mem);
+       }},
+
       {"seq_calloc",
        [](llvm::IRBuilder<> &B, const std::vector<llvm::Value *> &args) {
          auto *M = B.GetInsertBlock()->getModule();
@@ -350,7 +350,7 @@ void LLVMVisitor::dump(const std::string &filename) { writeToLLFile(filename, fa
 
 void LLVMVisitor::runLLVMPipeline() {
   db.builder->finalize();
-  optimize(M.get(), db.debug, db.jit, plugins);
+  optimize(M.get(), db.debug, db.jit, plugins, /*lineInfo=*/db.allocProfile);
 }
 
 void LLVMVisitor::writeToObjectFile(const std::string &filename, bool pic) {
@@ -1272,6 +1272,22 @@ void LLVMVisitor::run(const std::vector<std::string> &args,
       std::abort();
     });
   }
+  if (db.allocProfile) {
+    runtime::setAllocProfileSymbolizer(
+        [dbp](uintptr_t pc, std::vector<runtime::SymbolizedFrame> &frames) {
+          auto src = dbp->symbolize(pc);
+          if (auto err = src.takeError()) {
+            llvm::consumeError(std::move(err));
+            return false;
+          }
+          if (src->FunctionName == "<invalid>")
+            return false;
+          frames.push_back({src->FunctionName,
+                            src->FileName == "<invalid>" ? "" : src->FileName,
+                            static_cast<int>(src->Line)});
+          return true;
+        });
+  }
   t1.log();
 
   try {
@@ -1280,6 +1296,12 @@ void LLVMVisitor::run(const std::vector<std::string> &args,
     fmt::print(stderr, "{}\n", e.getOutput());
     std::abort();
   }
+
+  if (db.allocProfile) {
+    // symbolize while the JIT'd code and its debug info are still around
+    runtime::writeAllocProfile();
+    runtime::setAllocProfileSymbolizer({});
+  }
 }
 
 llvm::FunctionCallee LLVMVisitor::makeAllocFunc(bool atomic) {
@@ -1292,6 +1314,25 @@ llvm::FunctionCallee LLVMVisitor::makeAllocFunc(bool atomic) {
   return f;
 }
 
+llvm::FunctionCallee LLVMVisitor::makeTypedAllocFunc() {
+  auto f = M->getOrInsertFunction("seq_alloc_typed", B->getInt8PtrTy(), B->getInt64Ty(),
+                                  B->getInt8PtrTy());
+  auto *g = cast<llvm::Function>(f.getCallee());
+  g->setDoesNotThrow();
+  g->setReturnDoesNotAlias();
+  g->setOnlyAccessesInaccessibleMemOrArgMem();
+  return f;
+}
+
+llvm::FunctionCallee LLVMVisitor::makeTypedReallocFunc() {
+  auto f = M->getOrInsertFunction("seq_realloc_typed", B->getInt8PtrTy(),
+                                  B->getInt8PtrTy(), B->getInt64Ty(), B->getInt64Ty(),
+                                  B->getInt8PtrTy());
+  auto *g = cast<llvm::Function>(f.getCallee());
+  g->setDoesNotThrow();
+  return f;
+}
+
 llvm::FunctionCallee LLVMVisitor::makePersonalityFunc() {
   return M->getOrInsertFunction("seq_personality", B->getInt32Ty(), B->getInt32Ty(),
                                 B->getInt32Ty(), B->getInt64Ty(), B->getInt8PtrTy(),
@@ -1306,6 +1347,13 @@ llvm::FunctionCallee LLVMVisitor::makeExcAllocFunc() {
   return f;
 }
 
+llvm::FunctionCallee LLVMVisitor::makeExcFreeFunc() {
+  auto f = M->getOrInsertFunction("seq_free_exc", B->getVoidTy(), B->getInt8PtrTy());
+  auto *g = cast<llvm::Function>(f.getCallee());
+  g->setDoesNotThrow();
+  return f;
+}
+
 llvm::FunctionCallee LLVMVisitor::makeThrowFunc() {
   auto f = M->getOrInsertFunction("seq_throw", B->getVoidTy(), B->getInt8PtrTy());
   auto *g = cast<llvm::Function>(f.getCallee());
@@ -1371,6 +1419,75 @@ int LLVMVisitor::getTypeIdx(types::Type *catchType) {
   return typeIdxLookup(catchType ? catchType->getName() : "");
 }
 
+void LLVMVisitor::markPointerWords(types::Type *t, uint64_t offset,
+                                   std::vector<bool> &words) {
+  if (t->isAtomic())
+    return;
+  const auto &layout = M->getDataLayout();
+  auto *llvmType = getLLVMType(t);
+  if (auto *x = cast<types::RecordType>(t)) {
+    const auto *structLayout =
+        layout.getStructLayout(llvm::cast<llvm::StructType>(llvmType));
+    unsigned i = 0;
+    for (const auto &field : *x) {
+      markPointerWords(field.getType(), offset + structLayout->getElementOffset(i++),
+                       words);
+    }
+    return;
+  }
+  // anything else that can hold pointers (references, pointers, unions,
+  // optionals, ...) is scanned conservatively
+  const uint64_t word = layout.getPointerSize();
+  const uint64_t end = offset + layout.getTypeAllocSize(llvmType);
+  for (uint64_t w = offset / word; w * word < end; w++) {
+    words[w] = true;
+  }
+}
+
+llvm::Value *LLVMVisitor::getGCLayout(types::Type *t) {
+  if (t->isAtomic())
+    return nullptr;
+  const auto &layout = M->getDataLayout();
+  const uint64_t word = layout.getPointerSize();
+  const uint64_t size = layout.getTypeAllocSize(getLLVMType(t));
+  if (size == 0 || size % word != 0)
+    return nullptr;
+  std::vector<bool> words(size / word, false);
+  markPointerWords(t, 0, words);
+  // nothing to gain over conservative scanning if every word may be a pointer
+  if (std::all_of(words.begin(), words.end(), [](bool b) { return b; }))
+    return nullptr;
+
+  const std::string name = "codon.gc_layout." + t->getName();
+  if (auto *var = M->getGlobalVariable(name, /*AllowInternal=*/true))
+    return var;
+
+  std::vector<llvm::Constant *> bits((words.size() + 63) / 64, B->getInt64(0));
+  for (unsigned i = 0; i < bits.size(); i++) {
+    uint64_t chunk = 0;
+    for (unsigned j = 0; j < 64 && 64 * i + j < words.size(); j++) {
+      if (words[64 * i + j])
+        chunk |= uint64_t(1) << j;
+    }
+    bits[i] = B->getInt64(chunk);
+  }
+  auto *bitmapType = llvm::ArrayType::get(B->getInt64Ty(), bits.size());
+  auto *bitmap = new llvm::GlobalVariable(
+      *M, bitmapType, /*isConstant=*/true, llvm::GlobalValue::PrivateLinkage,
+      llvm::ConstantArray::get(bitmapType, bits), name + ".bitmap");
+  bitmap->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+
+  // {descriptor (filled in by the runtime), size, words, bitmap}; see lib.h
+  auto *layoutType = llvm::StructType::get(B->getInt64Ty(), B->getInt64Ty(),
+                                           B->getInt64Ty(), B->getInt8PtrTy());
+  return new llvm::GlobalVariable(
+      *M, layoutType, /*isConstant=*/false, llvm::GlobalValue::PrivateLinkage,
+      llvm::ConstantStruct::get(
+          layoutType, {B->getInt64(0), B->getInt64(size), B->getInt64(words.size()),
+                       llvm::ConstantExpr::getBitCast(bitmap, B->getInt8PtrTy())}),
+      name);
+}
+
 llvm::Value *LLVMVisitor::call(llvm::FunctionCallee callee,
                                llvm::ArrayRef<llvm::Value *> args) {
   B->SetInsertPoint(block);
@@ -1397,6 +1514,80 @@ void LLVMVisitor::exitLoop() {
   loops.pop_back();
 }
 
+// Loops with vectorization hints get them as loop metadata on their back
+// edges. Unless a safe length is given, iterations are independent, so all
+// memory accesses in the loop (the blocks that lead back to the header
+// without leaving through it) are marked as parallel as well.
+void LLVMVisitor::setLoopHints(const Flow *x, llvm::BasicBlock *header,
+                               llvm::BasicBlock *preheader) {
+  auto *hints = x->getAttribute<VectorizeAttribute>();
+  if (!hints)
+    return;
+
+  std::vector<llvm::Metadata *> md = {nullptr}; // self-reference
+  // the loop's location, which vectorization remarks refer to
+  if (auto *scope = func->getSubprogram()) {
+    auto *srcInfo = hints->loc.line > 0 ? &hints->loc : getSrcInfo(x);
+    md.push_back(llvm::DILocation::get(
+        *context, srcInfo->line, srcInfo->col,
+        db.builder->createLexicalBlockFile(scope, db.getFile(srcInfo->file))));
+  }
+  auto addHint = [&](const std::string &name, llvm::Metadata *value) {
+    md.push_back(
+        llvm::MDNode::get(*context, {llvm::MDString::get(*context, name), value}));
+  };
+
+  int64_t width = hints->width;
+  if (hints->safelen > 0 && (width <= 0 || width > hints->safelen))
+    width = hints->safelen;
+  addHint("llvm.loop.vectorize.enable", llvm::ConstantAsMetadata::get(B->getTrue()));
+  if (width > 0)
+    addHint("llvm.loop.vectorize.width",
+            llvm::ConstantAsMetadata::get(B->getInt32(width)));
+  if (hints->interleave > 0)
+    addHint("llvm.loop.interleave.count",
+            llvm::ConstantAsMetadata::get(B->getInt32(hints->interleave)));
+
+  if (hints->safelen <= 0) {
+    // walk back from the back edges to find the loop's blocks; blocks past
+    // the exit, or that only raise or return, are not part of it
+    llvm::SmallPtrSet<llvm::BasicBlock *, 16> blocks;
+    blocks.insert(header);
+    std::vector<llvm::BasicBlock *> worklist;
+    for (auto *pred : llvm::predecessors(header)) {
+      if (pred != preheader)
+        worklist.push_back(pred);
+    }
+    while (!worklist.empty()) {
+      auto *bb = worklist.back();
+      worklist.pop_back();
+      if (!blocks.insert(bb).second)
+        continue;
+      for (auto *pred : llvm::predecessors(bb))
+        worklist.push_back(pred);
+    }
+
+    auto *group = llvm::MDNode::getDistinct(*context, {});
+    for (auto *bb : blocks) {
+      for (auto &inst : *bb) {
+        if (!inst.mayReadOrWriteMemory())
+          continue;
+        auto *groups = llvm::uniteAccessGroups(
+            inst.getMetadata(llvm::LLVMContext::MD_access_group), group);
+        inst.setMetadata(llvm::LLVMContext::MD_access_group, groups);
+      }
+    }
+    addHint("llvm.loop.parallel_accesses", group);
+  }
+
+  auto *loopID = llvm::MDNode::getDistinct(*context, md);
+  loopID->replaceOperandWith(0, loopID);
+  for (auto *pred : llvm::predecessors(header)) {
+    if (pred != preheader)
+      pred->getTerminator()->setMetadata(llvm::LLVMContext::MD_loop, loopID);
+  }
+}
+
 void LLVMVisitor::enterTryCatch(TryCatchData data) {
   trycatch.push_back(std::move(data));
   trycatch.back().sequenceNumber = nextSequenceNumber++;
@@ -1527,7 +1718,8 @@ void LLVMVisitor::visit(const Module *x) {
   B->CreateStore(arr, argStorage);
   const int flags = (db.debug ? SEQ_FLAG_DEBUG : 0) |
                     (db.capture ? SEQ_FLAG_CAPTURE_OUTPUT : 0) |
-                    (db.standalone ? SEQ_FLAG_STANDALONE : 0);
+                    (db.standalone ? SEQ_FLAG_STANDALONE : 0) |
+                    (db.allocProfile ? SEQ_FLAG_ALLOC_PROFILE : 0);
   B->CreateCall(initFunc, B->getInt32(flags));
 
   // Put the entire program in a new function
@@ -1700,11 +1892,38 @@ void LLVMVisitor::visit(const InternalFunc *x) {
     auto *pointerType = cast<PointerType>(parentType);
     Type *baseType = pointerType->getBase();
     llvm::Type *llvmBaseType = getLLVMType(baseType);
-    auto allocFunc = makeAllocFunc(baseType->isAtomic());
     llvm::Value *elemSize =
         B->getInt64(M->getDataLayout().getTypeAllocSize(llvmBaseType));
     llvm::Value *allocSize = B->CreateMul(elemSize, args[0]);
-    result = B->CreateCall(allocFunc, allocSize);
+    if (auto *gcLayout = getGCLayout(baseType)) {
+      llvm::Value *layoutPtr = B->CreateBitCast(gcLayout, B->getInt8PtrTy());
+      result = B->CreateCall(makeTypedAllocFunc(), {allocSize, layoutPtr});
+    } else {
+      result = B->CreateCall(makeAllocFunc(baseType->isAtomic()), allocSize);
+    }
+    result = B->CreateBitCast(result, llvmBaseType->getPointerTo());
+  }
+
+  else if (internalFuncMatches<PointerType, PointerType, IntType, IntType>("__resize__",
+                                                                           x)) {
+    auto *pointerType = cast<PointerType>(parentType);
+    Type *baseType = pointerType->getBase();
+    llvm::Type *llvmBaseType = getLLVMType(baseType);
+    llvm::Value *elemSize =
+        B->getInt64(M->getDataLayout().getTypeAllocSize(llvmBaseType));
+    llvm::Value *ptr = B->CreateBitCast(args[0], B->getInt8PtrTy());
+    llvm::Value *newSize = B->CreateMul(elemSize, args[1]);
+    llvm::Value *oldSize = B->CreateMul(elemSize, args[2]);
+    if (auto *gcLayout = getGCLayout(baseType)) {
+      llvm::Value *layoutPtr = B->CreateBitCast(gcLayout, B->getInt8PtrTy());
+      result =
+          B->CreateCall(makeTypedReallocFunc(), {ptr, newSize, oldSize, layoutPtr});
+    } else {
+      auto reallocFunc = M->getOrInsertFunction("seq_realloc", B->getInt8PtrTy(),
+                                                B->getInt8PtrTy(), B->getInt64Ty(),
+                                                B->getInt64Ty());
+      result = B->CreateCall(reallocFunc, {ptr, newSize, oldSize});
+    }
     result = B->CreateBitCast(result, llvmBaseType->getPointerTo());
   }
 
@@ -2500,6 +2719,7 @@ void LLVMVisitor::visit(const WhileFlow *x) {
   auto *bodyBlock = llvm::BasicBlock::Create(*context, "while.body", func);
   auto *exitBlock = llvm::BasicBlock::Create(*context, "while.exit", func);
 
+  auto *preheader = block;
   B->SetInsertPoint(block);
   B->CreateBr(condBlock);
 
@@ -2517,6 +2737,7 @@ void LLVMVisitor::visit(const WhileFlow *x) {
   exitLoop();
   B->SetInsertPoint(block);
   B->CreateBr(condBlock);
+  setLoopHints(x, condBlock, preheader);
 
   block = exitBlock;
 }
@@ -2545,6 +2766,7 @@ void LLVMVisitor::visit(const ForFlow *x) {
 
   process(x->getIter());
   llvm::Value *iter = value;
+  auto *preheader = block;
   B->SetInsertPoint(block);
   B->CreateBr(condBlock);
 
@@ -2571,6 +2793,7 @@ void LLVMVisitor::visit(const ForFlow *x) {
   exitLoop();
   B->SetInsertPoint(block);
   B->CreateBr(condBlock);
+  setLoopHints(x, condBlock, preheader);
 
   B->SetInsertPoint(cleanupBlock);
   B->CreateCall(coroDestroy, iter);
@@ -2596,12 +2819,13 @@ void LLVMVisitor::visit(const ImperativeForFlow *x) {
   process(x->getEnd());
   llvm::Value *end = value;
 
+  auto *preheader = block;
   B->SetInsertPoint(block);
   B->CreateBr(condBlock);
   B->SetInsertPoint(condBlock);
 
   llvm::PHINode *phi = B->CreatePHI(B->getInt64Ty(), 2);
-  phi->addIncoming(start, block);
+  phi->addIncoming(start, preheader);
 
   llvm::Value *done =
       (x->getStep() > 0) ? B->CreateICmpSGE(phi, end) : B->CreateICmpSLE(phi, end);
@@ -2621,6 +2845,7 @@ void LLVMVisitor::visit(const ImperativeForFlow *x) {
   B->SetInsertPoint(updateBlock);
   phi->addIncoming(B->CreateAdd(phi, B->getInt64(x->getStep())), updateBlock);
   B->CreateBr(condBlock);
+  setLoopHints(x, condBlock, preheader);
 
   block = exitBlock;
 }
@@ -2940,6 +3165,9 @@ void LLVMVisitor::visit(const TryCatchFlow *x) {
       }
 
       B->CreateStore(excStateCaught, tc.excFlag);
+      // only the exception's object is used from here on; recycle the rest
+      B->CreateCall(makeExcFreeFunc(), B->CreateExtractValue(
+                                           B->CreateLoad(padType, tc.catchStore), 0));
       CatchData cd;
       cd.exception = objPtr;
       cd.typeId = objType;
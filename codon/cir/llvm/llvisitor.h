@@ -110,12 +110,14 @@ private:
     bool standalone;
     /// Whether to capture writes to stdout/stderr
     bool capture;
+    /// Whether to sample allocations and write a heap profile at exit
+    bool allocProfile;
     /// Program command-line flags
     std::string flags;
 
     DebugInfo()
         : builder(), unit(nullptr), debug(false), jit(false), standalone(false),
-          capture(false), flags() {}
+          capture(false), allocProfile(false), flags() {}
 
     llvm::DIFile *getFile(const std::string &path);
 
@@ -160,10 +162,15 @@ private:
 
   /// GC allocation functions
   llvm::FunctionCallee makeAllocFunc(bool atomic);
+  /// Typed GC allocation functions, for types with a pointer layout
+  llvm::FunctionCallee makeTypedAllocFunc();
+  llvm::FunctionCallee makeTypedReallocFunc();
   /// Personality function for exception handling
   llvm::FunctionCallee makePersonalityFunc();
   /// Exception allocation function
   llvm::FunctionCallee makeExcAllocFunc();
+  /// Exception release function, for exceptions that have been caught
+  llvm::FunctionCallee makeExcFreeFunc();
   /// Exception throw function
   llvm::FunctionCallee makeThrowFunc();
   /// Program termination function
@@ -177,6 +184,10 @@ private:
   llvm::GlobalVariable *getTypeIdxVar(types::Type *catchType);
   int getTypeIdx(types::Type *catchType = nullptr);
 
+  // Typed allocation utilities
+  void markPointerWords(types::Type *t, uint64_t offset, std::vector<bool> &words);
+  llvm::Value *getGCLayout(types::Type *t);
+
   // General function helpers
   llvm::Value *call(llvm::FunctionCallee callee, llvm::ArrayRef<llvm::Value *> args);
   llvm::Function *makeLLVMFunction(const Func *);
@@ -189,6 +200,8 @@ private:
   // Loop and try-catch state
   void enterLoop(LoopData data);
   void exitLoop();
+  void setLoopHints(const Flow *x, llvm::BasicBlock *header,
+                    llvm::BasicBlock *preheader);
   void enterTryCatch(TryCatchData data);
   void exitTryCatch();
   void enterCatch(CatchData data);
@@ -269,6 +282,12 @@ public:
   /// @param c true to capture
   void setCapture(bool c = true) { db.capture = c; }
 
+  /// @return true if profiling allocations, false otherwise
+  bool getAllocProfile() const { return db.allocProfile; }
+  /// Sets allocation profiling status.
+  /// @param p true to profile allocations
+  void setAllocProfile(bool p = true) { db.allocProfile = p; }
+
   /// @return program flags
   std::string getFlags() const { return db.flags; }
   /// Sets program flags.
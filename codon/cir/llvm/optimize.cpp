@@ -3,12 +3,20 @@
 #include "optimize.h"
 
 #include <algorithm>
+#include <string>
+#include <unordered_set>
 
 #include "codon/cir/llvm/gpu.h"
 #include "codon/util/common.h"
 
 static llvm::codegen::RegisterCodeGenFlags CFG;
 
+static llvm::cl::opt<bool>
+    vectorizeRemarks("vectorize-remarks",
+                     llvm::cl::desc("report which loops were vectorized and why "
+                                    "others were not"),
+                     llvm::cl::init(false));
+
 namespace codon {
 namespace ir {
 
@@ -49,7 +57,8 @@ getTargetMachine(llvm::Module *module, bool setFunctionAttributes, bool pic) {
 }
 
 namespace {
-void applyDebugTransformations(llvm::Module *module, bool debug, bool jit) {
+void applyDebugTransformations(llvm::Module *module, bool debug, bool jit,
+                               bool lineInfo) {
   if (debug) {
     // remove tail calls and fix linkage for stack traces
     for (auto &f : *module) {
@@ -71,11 +80,47 @@ void applyDebugTransformations(llvm::Module *module, bool debug, bool jit) {
         }
       }
     }
-  } else {
+  } else if (!vectorizeRemarks && !lineInfo) {
     llvm::StripDebugInfo(*module);
   }
 }
 
+/// Prints the loop vectorizer's remarks, which refer to loops by their
+/// source location, once each.
+class VectorizeRemarkHandler : public llvm::DiagnosticHandler {
+  std::unordered_set<std::string> seen;
+
+  static bool isVectorizerPass(llvm::StringRef name) {
+    return name == "loop-vectorize" || name == "transform-warning" ||
+           name == llvm::OptimizationRemarkAnalysis::AlwaysPrint;
+  }
+
+public:
+  bool isAnalysisRemarkEnabled(llvm::StringRef name) const override {
+    return name == "loop-vectorize";
+  }
+  bool isMissedOptRemarkEnabled(llvm::StringRef name) const override {
+    return name == "loop-vectorize";
+  }
+  bool isPassedOptRemarkEnabled(llvm::StringRef name) const override {
+    return name == "loop-vectorize";
+  }
+  bool isAnyRemarkEnabled() const override { return true; }
+
+  bool handleDiagnostics(const llvm::DiagnosticInfo &di) override {
+    auto *remark = llvm::dyn_cast<llvm::DiagnosticInfoOptimizationBase>(&di);
+    if (!remark || !isVectorizerPass(remark->getPassName()))
+      return false;
+    if (remark->isLocationAvailable()) {
+      auto msg = fmt::format("[vectorize] {}: {}", remark->getLocationStr(),
+                             remark->getMsg());
+      if (seen.insert(msg).second)
+        fmt::print(stderr, "{}\n", msg);
+    }
+    return true;
+  }
+};
+
 /// Lowers allocations of known, small size to alloca when possible.
 /// Also removes unused allocations.
 struct AllocationRemover : public llvm::PassInfoMixin<AllocationRemover> {
@@ -86,7 +131,8 @@ struct AllocationRemover : public llvm::PassInfoMixin<AllocationRemover> {
   explicit AllocationRemover(
       std::vector<std::string> allocators = {"seq_alloc", "seq_alloc_atomic",
                                              "seq_alloc_uncollectable",
-                                             "seq_alloc_atomic_uncollectable"},
+                                             "seq_alloc_atomic_uncollectable",
+                                             "seq_alloc_typed"},
       const std::string &realloc = "seq_realloc", const std::string &free = "seq_free")
       : allocators(std::move(allocators)), realloc(realloc), free(free) {}
 
@@ -108,8 +154,10 @@ struct AllocationRemover : public llvm::PassInfoMixin<AllocationRemover> {
 
   bool isAlloc(const llvm::Value *value) {
     if (auto *func = getCalledFunction(value)) {
-      return func->arg_size() == 1 && std::find(allocators.begin(), allocators.end(),
-                                                func->getName()) != allocators.end();
+      // size is always the first argument; typed allocation also takes a layout
+      return func->arg_size() >= 1 &&
+             std::find(allocators.begin(), allocators.end(), func->getName()) !=
+                 allocators.end();
     }
     return false;
   }
@@ -543,8 +591,8 @@ struct CoroBranchSimplifier : public llvm::PassInfoMixin<CoroBranchSimplifier> {
 };
 
 void runLLVMOptimizationPasses(llvm::Module *module, bool debug, bool jit,
-                               PluginManager *plugins) {
-  applyDebugTransformations(module, debug, jit);
+                               PluginManager *plugins, bool lineInfo) {
+  applyDebugTransformations(module, debug, jit, lineInfo);
 
   llvm::LoopAnalysisManager lam;
   llvm::FunctionAnalysisManager fam;
@@ -591,7 +639,7 @@ void runLLVMOptimizationPasses(llvm::Module *module, bool debug, bool jit,
     mpm.run(*module, mam);
   }
 
-  applyDebugTransformations(module, debug, jit);
+  applyDebugTransformations(module, debug, jit, lineInfo);
 }
 
 void verify(llvm::Module *module) {
@@ -601,15 +649,26 @@ void verify(llvm::Module *module) {
 
 } // namespace
 
-void optimize(llvm::Module *module, bool debug, bool jit, PluginManager *plugins) {
+void optimize(llvm::Module *module, bool debug, bool jit, PluginManager *plugins,
+              bool lineInfo) {
   verify(module);
+  if (vectorizeRemarks) {
+    module->getContext().setDiagnosticHandler(
+        std::make_unique<VectorizeRemarkHandler>());
+  }
   {
     TIME("llvm/opt1");
-    runLLVMOptimizationPasses(module, debug, jit, plugins);
+    runLLVMOptimizationPasses(module, debug, jit, plugins, lineInfo);
   }
   if (!debug) {
     TIME("llvm/opt2");
-    runLLVMOptimizationPasses(module, debug, jit, plugins);
+    runLLVMOptimizationPasses(module, debug, jit, plugins, lineInfo);
+  }
+  if (vectorizeRemarks) {
+    module->getContext().setDiagnosticHandler(
+        std::make_unique<llvm::DiagnosticHandler>());
+    if (!debug && !lineInfo)
+      llvm::StripDebugInfo(*module);
   }
   {
     TIME("llvm/gpu");
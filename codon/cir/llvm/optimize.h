@@ -18,7 +18,9 @@ std::unique_ptr<llvm::TargetMachine>
 getTargetMachine(llvm::Module *module, bool setFunctionAttributes = false,
                  bool pic = false);
 
+/// Runs the LLVM optimization pipeline. Outside of debug mode, debug info is
+/// stripped unless lineInfo is set (e.g. for symbolizing allocation profiles).
 void optimize(llvm::Module *module, bool debug, bool jit = false,
-              PluginManager *plugins = nullptr);
+              PluginManager *plugins = nullptr, bool lineInfo = false);
 } // namespace ir
 } // namespace codon
@@ -65,6 +65,12 @@ void ImperativeForFlowLowering::handle(ForFlow *v) {
   std::unique_ptr<parallel::OMPSched> sched;
   if (v->isParallel())
     sched = std::make_unique<parallel::OMPSched>(*v->getSchedule());
+  // vectorization hints carry over to the imperative loop
+  auto setHints = [v](ImperativeForFlow *loop) {
+    if (auto *hints = v->getAttribute<VectorizeAttribute>())
+      loop->setAttribute(std::make_unique<VectorizeAttribute>(*hints));
+    return loop;
+  };
 
   if (auto *rangeCall = getRangeIter(iter)) {
     auto it = rangeCall->begin();
@@ -102,8 +108,8 @@ void ImperativeForFlowLowering::handle(ForFlow *v) {
     if (step == 0)
       return;
 
-    v->replaceAll(M->N<ImperativeForFlow>(v->getSrcInfo(), start, step, end,
-                                          v->getBody(), v->getVar(), std::move(sched)));
+    v->replaceAll(setHints(M->N<ImperativeForFlow>(
+        v->getSrcInfo(), start, step, end, v->getBody(), v->getVar(), std::move(sched))));
   } else if (auto *list = getListIter(iter)) {
     // convert:
     //   for a in list:
@@ -129,8 +135,8 @@ void ImperativeForFlowLowering::handle(ForFlow *v) {
     auto *oldLoopVar = v->getVar();
     auto *newLoopVar = M->Nr<Var>(M->getIntType());
     parent->push_back(newLoopVar);
-    auto *replacement = M->N<ImperativeForFlow>(
-        v->getSrcInfo(), M->getInt(0), 1, lenVar, body, newLoopVar, std::move(sched));
+    auto *replacement = setHints(M->N<ImperativeForFlow>(
+        v->getSrcInfo(), M->getInt(0), 1, lenVar, body, newLoopVar, std::move(sched)));
     series->push_back(replacement);
     body->insert(
         body->begin(),
@@ -7,6 +7,7 @@
 #include "codon/cir/util/cloning.h"
 #include "codon/cir/util/irtools.h"
 #include "codon/cir/util/matching.h"
+#include "codon/cir/util/outlining.h"
 
 namespace codon {
 namespace ir {
@@ -21,46 +22,180 @@ Value *callStage(Module *M, PipelineFlow::Stage *stage, Value *last) {
   return M->N<CallInstr>(stage->getCallee()->getSrcInfo(), stage->getCallee(), args);
 }
 
+const std::string parallelModule = "std.openmp";
+
+struct ParallelOptions {
+  int64_t chunkSize;
+  bool keepOrder;
+  bool staged;
+};
+
+// Stages [start, end) of a pipeline, run on their own thread(s) if the
+// pipeline is split into stage groups. The group's output goes to the
+// sink queue, or to nowhere if it is the last group.
+struct StageGroup {
+  unsigned start;
+  unsigned end;
+  Var *sink;
+};
+
+Value *pipeCall(Module *M, const std::string &name, std::vector<Value *> args,
+                std::vector<types::Generic> generics = {}) {
+  std::vector<types::Type *> types;
+  for (auto *arg : args)
+    types.push_back(arg->getType());
+  auto *func = M->getOrRealizeFunc(name, types, std::move(generics), parallelModule);
+  seqassertn(func, "pipeline function '{}' not found", name);
+  return util::call(func, args);
+}
+
 Value *convertPipelineToForLoopsHelper(Module *M, BodiedFunc *parent,
                                        const std::vector<PipelineFlow::Stage *> &stages,
-                                       unsigned idx = 0, Value *last = nullptr) {
+                                       const ParallelOptions &par,
+                                       const StageGroup &group, unsigned idx,
+                                       Value *last = nullptr) {
   if (idx >= stages.size())
     return last;
 
   auto *stage = stages[idx];
   if (idx == 0)
-    return convertPipelineToForLoopsHelper(M, parent, stages, idx + 1,
+    return convertPipelineToForLoopsHelper(M, parent, stages, par, group, idx + 1,
                                            stage->getCallee());
 
   auto *prev = stages[idx - 1];
   if (prev->isGenerator()) {
     auto *var = M->Nr<Var>(prev->getOutputElementType());
     parent->push_back(var);
-    auto *body = convertPipelineToForLoopsHelper(
-        M, parent, stages, idx + 1, callStage(M, stage, M->Nr<VarValue>(var)));
+    Value *body = nullptr;
+    if (idx == group.end) {
+      // hand the item over to the next stage group
+      body = pipeCall(M, "_pipe_push",
+                      {M->Nr<VarValue>(group.sink), M->Nr<VarValue>(var)});
+    } else {
+      body = convertPipelineToForLoopsHelper(M, parent, stages, par, group, idx + 1,
+                                             callStage(M, stage, M->Nr<VarValue>(var)));
+    }
     auto *loop = M->N<ForFlow>(last->getSrcInfo(), last, util::series(body), var);
-    if (stage->isParallel())
-      loop->setParallel();
+    if (stage->isParallel() && !par.staged) {
+      // each task runs a batch of items if a chunk size is given
+      auto *chunk = (par.chunkSize > 1) ? M->getInt(par.chunkSize) : nullptr;
+      loop->setSchedule(std::make_unique<parallel::OMPSched>(
+          /*code=*/-1, /*dynamic=*/false, /*threads=*/nullptr, chunk,
+          /*ordered=*/false, /*collapse=*/0, /*gpu=*/false, par.keepOrder));
+    }
     return loop;
   } else {
-    return convertPipelineToForLoopsHelper(M, parent, stages, idx + 1,
+    return convertPipelineToForLoopsHelper(M, parent, stages, par, group, idx + 1,
                                            callStage(M, stage, last));
   }
 }
 
-Value *convertPipelineToForLoops(PipelineFlow *p, BodiedFunc *parent) {
+// Wraps a call to an outlined stage group in a function that takes a
+// pointer to the call's arguments, so it can be run on another thread.
+Func *makeStageEntry(Module *M, CallInstr *call, types::Type *argsType) {
+  auto *entry = M->Nr<BodiedFunc>("__pipeline_stage");
+  entry->realize(M->getFuncType(M->getNoneType(), {M->getPointerType(argsType)}),
+                 {"args"});
+  auto *argsVar = entry->arg_front();
+  std::vector<Value *> args;
+  for (unsigned i = 0; i < call->numArgs(); i++)
+    args.push_back(util::tupleGet(util::ptrLoad(M->Nr<VarValue>(argsVar)), i));
+  entry->setBody(util::series(util::call(util::getFunc(call->getCallee()), args)));
+  return entry;
+}
+
+// Runs each group of stages between '||>' operators on its own thread(s),
+// connected by bounded queues. The first group, which produces the items,
+// always runs on a single thread.
+Value *convertPipelineToStages(PipelineFlow *p, BodiedFunc *parent,
+                               const std::vector<PipelineFlow::Stage *> &stages,
+                               const std::vector<unsigned> &bounds,
+                               const ParallelOptions &par, int64_t workers,
+                               int64_t queueSize) {
+  auto *M = p->getModule();
+  auto *series = M->Nr<SeriesFlow>();
+  std::vector<Var *> queues;
+  for (unsigned k = 0; k < bounds.size(); k++) {
+    auto *type = stages[bounds[k] - 1]->getOutputElementType();
+    auto *producers = M->getInt(k == 0 ? 1 : workers);
+    queues.push_back(util::getVar(util::makeVar(
+        pipeCall(M, "_pipe_queue", {M->getInt(queueSize), producers}, {type}), series,
+        parent)));
+  }
+  auto *threads = util::getVar(util::makeVar(pipeCall(M, "_pipe_threads", {}), series,
+                                             parent));
+
+  std::vector<SeriesFlow *> groups;
+  for (unsigned g = 0; g <= bounds.size(); g++) {
+    StageGroup group = {g == 0 ? 0 : bounds[g - 1],
+                        g < bounds.size() ? bounds[g] : unsigned(stages.size()),
+                        g < bounds.size() ? queues[g] : nullptr};
+    Value *last = g == 0 ? nullptr
+                         : pipeCall(M, "_pipe_iter", {M->Nr<VarValue>(queues[g - 1])});
+    auto *groupSeries = M->Nr<SeriesFlow>();
+    auto *loops = convertPipelineToForLoopsHelper(M, parent, stages, par, group,
+                                                  group.start, last);
+    groupSeries->push_back(loops);
+    if (group.sink)
+      groupSeries->push_back(pipeCall(M, "_pipe_close", {M->Nr<VarValue>(group.sink)}));
+    series->push_back(groupSeries);
+    groups.push_back(groupSeries);
+  }
+
+  series->push_back(pipeCall(M, "_pipe_join", {M->Nr<VarValue>(threads)}));
+  for (auto *queue : queues)
+    series->push_back(pipeCall(M, "_pipe_free", {M->Nr<VarValue>(queue)}));
+  p->replaceAll(series);
+
+  for (unsigned g = 0; g < groups.size(); g++) {
+    auto outline = util::outlineRegion(parent, groups[g], /*allowOutflows=*/false);
+    seqassertn(outline, "could not outline pipeline stage group");
+    std::vector<Value *> args(outline.call->begin(), outline.call->end());
+    auto *argsTuple = util::makeTuple(args, M);
+    auto *entry = makeStageEntry(M, outline.call, argsTuple->getType());
+    auto *rawEntry = util::call(
+        M->getOrRealizeMethod(entry->getType(), "__raw__", {entry->getType()}),
+        {M->Nr<VarValue>(entry)});
+    outline.call->replaceAll(
+        pipeCall(M, "_pipe_spawn",
+                 {M->Nr<VarValue>(threads), M->getInt(g == 0 ? 1 : workers), rawEntry,
+                  argsTuple}));
+  }
+  return series;
+}
+
+std::vector<PipelineFlow::Stage *> getStages(PipelineFlow *p) {
   std::vector<PipelineFlow::Stage *> stages;
   for (auto &stage : *p) {
     stages.push_back(&stage);
   }
-  return convertPipelineToForLoopsHelper(p->getModule(), parent, stages);
+  return stages;
 }
 } // namespace
 
 const std::string PipelineLowering::KEY = "core-pipeline-lowering";
 
 void PipelineLowering::handle(PipelineFlow *v) {
-  v->replaceAll(convertPipelineToForLoops(v, cast<BodiedFunc>(getParentFunc())));
+  auto *parent = cast<BodiedFunc>(getParentFunc());
+  auto stages = getStages(v);
+  ParallelOptions par = {parallelChunkSize, parallelKeepOrder, stageWorkers > 0};
+
+  if (par.staged) {
+    // '||>' after a generator stage starts a new stage group
+    std::vector<unsigned> bounds;
+    for (unsigned i = 1; i < stages.size(); i++) {
+      if (stages[i]->isParallel() && stages[i - 1]->isGenerator())
+        bounds.push_back(i);
+    }
+    if (!bounds.empty()) {
+      convertPipelineToStages(v, parent, stages, bounds, par, stageWorkers, queueSize);
+      return;
+    }
+  }
+
+  StageGroup group = {0, unsigned(stages.size()), nullptr};
+  v->replaceAll(convertPipelineToForLoopsHelper(v->getModule(), parent, stages, par,
+                                                group, /*idx=*/0));
 }
 
 } // namespace lowering
@@ -9,12 +9,50 @@ namespace ir {
 namespace transform {
 namespace lowering {
 
-/// Converts pipelines to for-loops
+/// Converts pipelines to for-loops. By default, the part of a pipeline
+/// after a parallel pipe ('||>') becomes a parallel loop that spawns tasks.
+/// Alternatively, each group of stages between parallel pipes can run on
+/// its own thread(s), with the groups connected by bounded queues.
 class PipelineLowering : public OperatorPass {
+private:
+  /// number of items per task in parallel stages
+  int64_t parallelChunkSize;
+  /// whether lists built up in parallel stages keep item order
+  bool parallelKeepOrder;
+  /// number of threads per stage group, or zero to spawn tasks instead
+  int64_t stageWorkers;
+  /// capacity of the queues between stage groups
+  int64_t queueSize;
+
 public:
   static const std::string KEY;
+
+  /// Constructs a pipeline lowering pass.
+  /// @param parallelChunkSize number of items per task in parallel stages
+  /// @param parallelKeepOrder whether parallel stages keep item order
+  explicit PipelineLowering(int64_t parallelChunkSize = 1,
+                            bool parallelKeepOrder = false)
+      : OperatorPass(), parallelChunkSize(parallelChunkSize),
+        parallelKeepOrder(parallelKeepOrder), stageWorkers(0), queueSize(1024) {}
+
   std::string getKey() const override { return KEY; }
   void handle(PipelineFlow *v) override;
+
+  /// Sets the schedule of loops generated for parallel stages.
+  /// @param chunkSize number of items per task
+  /// @param keepOrder whether lists built up in the loop keep item order
+  void setParallelSchedule(int64_t chunkSize, bool keepOrder) {
+    parallelChunkSize = chunkSize;
+    parallelKeepOrder = keepOrder;
+  }
+
+  /// Runs stage groups between parallel pipes on their own threads.
+  /// @param workers number of threads per stage group after the first
+  /// @param size capacity of the queues between stage groups
+  void setStaged(int64_t workers, int64_t size) {
+    stageWorkers = workers;
+    queueSize = size;
+  }
 };
 
 } // namespace lowering
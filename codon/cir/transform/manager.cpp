@@ -17,6 +17,7 @@
 #include "codon/cir/transform/manager.h"
 #include "codon/cir/transform/parallel/openmp.h"
 #include "codon/cir/transform/pass.h"
+#include "codon/cir/transform/polymorphism/devirtualize.h"
 #include "codon/cir/transform/pythonic/dict.h"
 #include "codon/cir/transform/pythonic/generator.h"
 #include "codon/cir/transform/pythonic/io.h"
@@ -161,11 +162,19 @@ void PassManager::registerStandardPasses(PassManager::Init init) {
   case Init::JIT: {
     // Pythonic
     registerPass(std::make_unique<pythonic::DictArithmeticOptimization>());
+    registerPass(std::make_unique<pythonic::DictKeyErrorOptimization>());
     registerPass(std::make_unique<pythonic::ListAdditionOptimization>());
     registerPass(std::make_unique<pythonic::StrAdditionOptimization>());
     registerPass(std::make_unique<pythonic::GeneratorArgumentOptimization>());
     registerPass(std::make_unique<pythonic::IOCatOptimization>());
 
+    // polymorphism
+    if (init != Init::JIT) {
+      // Don't devirtualize in JIT mode, since new classes might be
+      // realized later by another user input.
+      registerPass(std::make_unique<polymorphism::DevirtualizationPass>());
+    }
+
     // lowering
     registerPass(std::make_unique<lowering::PipelineLowering>());
     registerPass(std::make_unique<lowering::ImperativeForFlowLowering>());
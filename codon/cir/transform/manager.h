@@ -141,6 +141,14 @@ public:
     return false;
   }
 
+  /// Gets a registered pass.
+  /// @param key the (unique'd) pass key
+  /// @return the pass, or null if not registered
+  Pass *getPass(const std::string &key) {
+    auto it = passes.find(key);
+    return it != passes.end() ? it->second.pass.get() : nullptr;
+  }
+
   /// Registers a pass and appends it to the execution order.
   /// @param pass the pass
   /// @param insertBefore insert pass before the pass with this given key
@@ -0,0 +1,582 @@
+// Copyright (C) 2022-2023 Exaloop Inc. <https://exaloop.io>
+
+#include "autopar.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "codon/cir/analyze/module/side_effect.h"
+#include "codon/cir/transform/parallel/schedule.h"
+#include "codon/cir/util/cloning.h"
+#include "codon/cir/util/irtools.h"
+#include "codon/cir/util/operator.h"
+
+namespace codon {
+namespace ir {
+namespace transform {
+namespace parallel {
+namespace {
+const std::string LIST = "std.internal.types.ptr.List";
+const int64_t UNKNOWN_TRIP_COUNT = 16;
+const int64_t MAX_WEIGHT = 1 << 20;
+const int64_t CALL_COST = 8;
+
+bool isList(types::Type *type) { return type->getName().rfind(LIST + "[", 0) == 0; }
+
+bool isVarValueOf(Value *v, Var *var) {
+  auto *vv = cast<VarValue>(v);
+  return vv && vv->getVar()->getId() == var->getId();
+}
+
+/// @return the root variable of a chain of member accesses, or null
+/// if the value is not such a chain
+Var *getRootVar(Value *v) {
+  if (auto *vv = cast<VarValue>(v))
+    return vv->getVar();
+  if (auto *e = cast<ExtractInstr>(v))
+    return getRootVar(e->getVal());
+  return nullptr;
+}
+
+/// @return the trip count of the given loop, or -1 if not known statically
+int64_t getTripCount(ImperativeForFlow *v) {
+  if (!util::isConst<int64_t>(v->getStart()) || !util::isConst<int64_t>(v->getEnd()))
+    return -1;
+  auto start = util::getConst<int64_t>(v->getStart());
+  auto end = util::getConst<int64_t>(v->getEnd());
+  auto step = v->getStep();
+  if (step > 0)
+    return (end > start) ? (end - start + step - 1) / step : 0;
+  else
+    return (start > end) ? (start - end - step - 1) / (-step) : 0;
+}
+
+struct VarUseCounter : public util::Operator {
+  std::unordered_map<id_t, int64_t> counts;
+
+  void preHook(Node *v) override {
+    for (auto *var : v->getUsedVariables()) {
+      ++counts[var->getId()];
+    }
+  }
+
+  int64_t count(Var *var) const {
+    auto it = counts.find(var->getId());
+    return (it != counts.end()) ? it->second : 0;
+  }
+};
+
+struct LoopCollector : public util::Operator {
+  std::unordered_set<id_t> &loops;
+
+  explicit LoopCollector(std::unordered_set<id_t> &loops)
+      : util::Operator(), loops(loops) {}
+
+  void handle(ForFlow *v) override { loops.insert(v->getId()); }
+  void handle(ImperativeForFlow *v) override { loops.insert(v->getId()); }
+};
+
+/// Dependence and cost analysis for the body of a candidate loop. Bodies
+/// are scanned in program order to find variables that are read before
+/// being assigned in an iteration; stores are only allowed to lists
+/// indexed by the loop variable, and calls only to functions without
+/// visible side effects.
+struct LoopAnalyzer {
+  ImperativeForFlow *loop;
+  analyze::module::SideEffectResult *se;
+  /// reason the loop cannot be parallelized, or empty if none
+  std::string reason;
+
+  /// vars definitely assigned so far in the current iteration
+  std::unordered_set<id_t> defined;
+  /// vars read before being assigned in an iteration
+  std::unordered_set<id_t> exposed;
+  /// vars assigned in the loop body
+  std::unordered_map<id_t, Var *> assigned;
+  /// number of reads of each var in the loop body
+  std::unordered_map<id_t, int64_t> reads;
+  /// reduction operator for each var, or empty if not a reduction
+  std::unordered_map<id_t, std::string> updates;
+  /// reads that occur as part of a reduction update
+  std::unordered_map<id_t, int64_t> updateReads;
+  /// list types that are stored to in the loop body
+  std::vector<types::Type *> storedTypes;
+  /// list values that are indexed by the loop variable
+  std::unordered_set<id_t> indexed;
+  /// all list values in the loop body
+  std::vector<Value *> lists;
+  /// vars through which lists are stored to
+  std::vector<Var *> storeRoots;
+
+  /// current inner loop depth
+  int depth = 0;
+  /// true if iterations might be unbalanced
+  bool irregular = false;
+  /// estimated cost of one iteration
+  int64_t cost = 0;
+  /// current cost multiplier
+  int64_t weight = 1;
+
+  LoopAnalyzer(ImperativeForFlow *loop, analyze::module::SideEffectResult *se)
+      : loop(loop), se(se) {}
+
+  void fail(const std::string &msg) {
+    if (reason.empty())
+      reason = msg;
+  }
+
+  void addCost(int64_t c) {
+    cost = std::min(cost + c * weight, std::numeric_limits<int64_t>::max() / 2);
+  }
+
+  void define(Var *var) {
+    assigned.emplace(var->getId(), var);
+    defined.insert(var->getId());
+  }
+
+  std::string getReductionOp(AssignInstr *v) {
+    auto *M = v->getModule();
+    auto *var = v->getLhs();
+    auto *type = var->getType();
+    auto *rhs = v->getRhs();
+    bool isInt = isA<types::IntType>(type);
+    if (!isInt && !isA<types::FloatType>(type) && !isA<types::Float32Type>(type))
+      return "";
+
+    std::vector<std::string> ops = {Module::ADD_MAGIC_NAME, Module::MUL_MAGIC_NAME};
+    if (isInt) {
+      ops.push_back(Module::AND_MAGIC_NAME);
+      ops.push_back(Module::OR_MAGIC_NAME);
+      ops.push_back(Module::XOR_MAGIC_NAME);
+    }
+
+    std::vector<Value *> operands;
+    std::string result;
+    for (auto &op : ops) {
+      if (util::isCallOf(rhs, op, {type, type}, type, /*method=*/true)) {
+        std::vector<Value *> open = {rhs};
+        while (!open.empty()) {
+          auto *x = open.back();
+          open.pop_back();
+          if (util::isCallOf(x, op, {type, type}, type, /*method=*/true)) {
+            auto *call = cast<CallInstr>(x);
+            open.push_back(call->back());
+            open.push_back(call->front());
+          } else {
+            operands.push_back(x);
+          }
+        }
+        result = op;
+        break;
+      }
+    }
+
+    if (result.empty()) {
+      auto *noneType = M->getOptionalType(M->getNoneType());
+      for (std::string op : {"min", "max"}) {
+        if (util::isCallOf(rhs, op, {M->getTupleType({type, type}), noneType, noneType},
+                           type, /*method=*/false)) {
+          if (auto *tuple = cast<CallInstr>(cast<CallInstr>(rhs)->front()))
+            operands.insert(operands.end(), tuple->begin(), tuple->end());
+          result = op;
+          break;
+        }
+      }
+    }
+
+    if (std::count_if(operands.begin(), operands.end(),
+                      [var](Value *x) { return isVarValueOf(x, var); }) != 1)
+      return "";
+    return result;
+  }
+
+  void recordUpdate(AssignInstr *v) {
+    auto *var = v->getLhs();
+    auto op = getReductionOp(v);
+    auto it = updates.find(var->getId());
+    if (it == updates.end()) {
+      updates.emplace(var->getId(), op);
+    } else if (it->second != op) {
+      it->second = "";
+    }
+    if (!op.empty())
+      ++updateReads[var->getId()];
+  }
+
+  bool handleListAccess(CallInstr *v) {
+    auto *func = util::getFunc(v->getCallee());
+    if (!func || v->numArgs() == 0 || !isList(v->front()->getType()))
+      return false;
+    auto name = func->getUnmangledName();
+    auto *self = v->front();
+
+    if (name == Module::LEN_MAGIC_NAME || name == "len") {
+      indexed.insert(self->getId());
+      return false;
+    }
+
+    if (v->numArgs() < 2 || !isVarValueOf(*(v->begin() + 1), loop->getVar()))
+      return false;
+
+    if (name == Module::GETITEM_MAGIC_NAME && v->numArgs() == 2) {
+      indexed.insert(self->getId());
+      return false;
+    }
+
+    if (name == Module::SETITEM_MAGIC_NAME && v->numArgs() == 3) {
+      // negative indices wrap around, so we need to know the loop
+      // variable stays non-negative
+      if (loop->getStep() < 0 || !util::isConst<int64_t>(loop->getStart()) ||
+          util::getConst<int64_t>(loop->getStart()) < 0) {
+        fail("list store index might be negative");
+        return true;
+      }
+      auto *root = getRootVar(self);
+      if (!root) {
+        fail("list store through a complex expression");
+        return true;
+      }
+      storeRoots.push_back(root);
+      storedTypes.push_back(self->getType());
+      indexed.insert(self->getId());
+      for (auto *arg : *v) {
+        scan(arg);
+      }
+      return true;
+    }
+    return false;
+  }
+
+  void handleCall(CallInstr *v) {
+    addCost(1);
+    auto *func = util::getFunc(v->getCallee());
+    if (!func) {
+      fail("indirect call");
+      return;
+    }
+    if (isA<BodiedFunc>(func))
+      addCost(CALL_COST - 1);
+
+    if (handleListAccess(v))
+      return;
+
+    auto it = se->result.find(func->getId());
+    if (it == se->result.end() || it->second > util::SideEffectStatus::NO_CAPTURE) {
+      fail("call to '" + func->getUnmangledName() + "' may have side effects");
+      return;
+    }
+    for (auto *arg : *v) {
+      scan(arg);
+    }
+  }
+
+  void scanBranches(Value *a, Value *b) {
+    auto saved = defined;
+    scan(a);
+    auto definedA = defined;
+    defined = saved;
+    scan(b);
+    std::unordered_set<id_t> both;
+    for (auto id : definedA) {
+      if (defined.count(id))
+        both.insert(id);
+    }
+    defined = both;
+  }
+
+  void scanInnerLoop(Var *var, Value *body, int64_t tripCount) {
+    auto saved = defined;
+    auto savedWeight = weight;
+    weight = std::min(weight * std::max(tripCount, int64_t(1)), MAX_WEIGHT);
+    ++depth;
+    if (var) {
+      define(var);
+      updates[var->getId()] = "";
+    }
+    scan(body);
+    --depth;
+    weight = savedWeight;
+    defined = saved;
+  }
+
+  void scan(Value *v) {
+    if (!v || !reason.empty())
+      return;
+
+    if (isList(v->getType()))
+      lists.push_back(v);
+
+    if (auto *x = cast<VarValue>(v)) {
+      auto *var = x->getVar();
+      if (isA<Func>(var))
+        return;
+      ++reads[var->getId()];
+      if (defined.count(var->getId()) == 0)
+        exposed.insert(var->getId());
+    } else if (auto *x = cast<SeriesFlow>(v)) {
+      for (auto *c : *x) {
+        scan(c);
+      }
+    } else if (auto *x = cast<IfFlow>(v)) {
+      irregular = true;
+      scan(x->getCond());
+      scanBranches(x->getTrueBranch(), x->getFalseBranch());
+    } else if (auto *x = cast<TernaryInstr>(v)) {
+      irregular = true;
+      scan(x->getCond());
+      scanBranches(x->getTrueValue(), x->getFalseValue());
+    } else if (auto *x = cast<WhileFlow>(v)) {
+      irregular = true;
+      scanInnerLoop(nullptr, x->getCond(), UNKNOWN_TRIP_COUNT);
+      scanInnerLoop(nullptr, x->getBody(), UNKNOWN_TRIP_COUNT);
+    } else if (auto *x = cast<ImperativeForFlow>(v)) {
+      scan(x->getStart());
+      scan(x->getEnd());
+      auto trip = getTripCount(x);
+      if (trip < 0) {
+        irregular = true;
+        trip = UNKNOWN_TRIP_COUNT;
+      }
+      scanInnerLoop(x->getVar(), x->getBody(), trip);
+    } else if (auto *x = cast<ForFlow>(v)) {
+      irregular = true;
+      scan(x->getIter());
+      scanInnerLoop(x->getVar(), x->getBody(), UNKNOWN_TRIP_COUNT);
+    } else if (auto *x = cast<AssignInstr>(v)) {
+      addCost(1);
+      scan(x->getRhs());
+      recordUpdate(x);
+      define(x->getLhs());
+    } else if (auto *x = cast<CallInstr>(v)) {
+      handleCall(x);
+    } else if (auto *x = cast<ExtractInstr>(v)) {
+      addCost(1);
+      scan(x->getVal());
+    } else if (auto *x = cast<FlowInstr>(v)) {
+      scan(x->getFlow());
+      scan(x->getValue());
+    } else if (isA<BreakInstr>(v) || isA<ContinueInstr>(v)) {
+      if (depth == 0)
+        fail("contains break or continue");
+    } else if (isA<ReturnInstr>(v)) {
+      fail("contains return");
+    } else if (isA<YieldInstr>(v) || isA<YieldInInstr>(v)) {
+      fail("contains yield");
+    } else if (isA<ThrowInstr>(v) || isA<TryCatchFlow>(v)) {
+      fail("contains exception handling");
+    } else if (auto *x = cast<PointerValue>(v)) {
+      fail("takes the address of '" + x->getVar()->getName() + "'");
+    } else if (isA<InsertInstr>(v)) {
+      fail("modifies an object field");
+    } else if (isA<StackAllocInstr>(v)) {
+      fail("contains a stack allocation");
+    } else if (isA<Const>(v) || isA<TypePropertyInstr>(v)) {
+      // nothing to do
+    } else {
+      fail("contains unsupported IR node");
+    }
+  }
+};
+} // namespace
+
+const std::string AutoParallelizationPass::KEY = "core-parallel-auto";
+
+void AutoParallelizationPass::run(Module *module) {
+  report.clear();
+  ignored.clear();
+  OperatorPass::run(module);
+
+  if (!printReport)
+    return;
+  for (auto &entry : report) {
+    fmt::print(stderr, "[auto-par] {}: {}: {}\n", entry.src,
+               entry.parallelized ? "parallelized" : "not parallelized", entry.reason);
+  }
+}
+
+bool AutoParallelizationPass::shouldProcess(Flow *v) {
+  if (ignored.count(v->getId()))
+    return false;
+  auto *func = getParentFunc();
+  if (!func || util::isStdlibFunc(func))
+    return false;
+  for (auto it = parent_begin(); it != parent_end(); ++it) {
+    if (auto *f = cast<ImperativeForFlow>(*it)) {
+      if (f->isParallel())
+        return false;
+    } else if (auto *f = cast<ForFlow>(*it)) {
+      if (f->isParallel())
+        return false;
+    }
+  }
+  return true;
+}
+
+void AutoParallelizationPass::accept(Flow *v, const std::string &reason) {
+  report.push_back({v->getSrcInfo(), true, reason});
+}
+
+void AutoParallelizationPass::reject(Flow *v, const std::string &reason) {
+  report.push_back({v->getSrcInfo(), false, reason});
+}
+
+void AutoParallelizationPass::handle(ForFlow *v) {
+  if (v->isParallel() || !shouldProcess(v))
+    return;
+  reject(v, "not a loop over a range");
+}
+
+void AutoParallelizationPass::handle(ImperativeForFlow *v) {
+  if (v->isParallel() || !shouldProcess(v))
+    return;
+
+  auto *M = v->getModule();
+  auto *parent = cast<BodiedFunc>(getParentFunc());
+  auto *se = getAnalysisResult<analyze::module::SideEffectResult>(sideEffectsKey);
+  if (!parent || !se || !cast<SeriesFlow>(v->getBody()))
+    return;
+
+  LoopAnalyzer la(v, se);
+  la.scan(v->getBody());
+  if (!la.reason.empty()) {
+    reject(v, la.reason);
+    return;
+  }
+
+  VarUseCounter fnUses, bodyUses;
+  parent->accept(fnUses);
+  v->getBody()->accept(bodyUses);
+  auto usedOutside = [&](Var *var) {
+    auto n = fnUses.count(var) - bodyUses.count(var);
+    return (var->getId() == v->getVar()->getId()) ? (n > 1) : (n > 0);
+  };
+
+  if (usedOutside(v->getVar())) {
+    reject(v, "loop variable '" + v->getVar()->getName() + "' is used after the loop");
+    return;
+  }
+
+  // classify assigned vars as either private or reductions
+  std::vector<std::string> reductions;
+  std::unordered_map<id_t, Var *> privates;
+  for (auto &[id, var] : la.assigned) {
+    if (id == v->getVar()->getId()) {
+      reject(v, "loop variable '" + var->getName() + "' is reassigned");
+      return;
+    }
+
+    const bool shared = var->isGlobal() || usedOutside(var);
+    if (shared) {
+      auto it = la.updates.find(id);
+      if (it != la.updates.end() && !it->second.empty() &&
+          la.reads[id] == la.updateReads[id]) {
+        reductions.push_back(var->getName());
+        continue;
+      }
+      reject(v, var->isGlobal()
+                    ? "global variable '" + var->getName() + "' is assigned"
+                    : "'" + var->getName() + "' is assigned and used after the loop");
+      return;
+    }
+
+    if (la.exposed.count(id)) {
+      reject(v, "'" + var->getName() + "' carries a value across iterations");
+      return;
+    }
+    privates.emplace(id, M->Nr<Var>(var->getType(), /*global=*/false, /*external=*/false,
+                                    var->getName()));
+  }
+
+  for (auto *root : la.storeRoots) {
+    if (la.assigned.count(root->getId())) {
+      reject(v, "list '" + root->getName() + "' is reassigned while being stored to");
+      return;
+    }
+  }
+
+  // lists of a stored type might alias, so they can only be accessed
+  // at the current iteration's index
+  for (auto *list : la.lists) {
+    if (la.indexed.count(list->getId()))
+      continue;
+    for (auto *type : la.storedTypes) {
+      if (list->getType()->is(type)) {
+        reject(v, "list of type '" + type->getName() +
+                      "' is stored to and accessed other than at the loop index");
+        return;
+      }
+    }
+  }
+
+  // cost model
+  auto bodyCost = std::max(la.cost, int64_t(1));
+  auto tripCount = getTripCount(v);
+  int64_t minTrips = 0;
+  if (tripCount >= 0) {
+    if (tripCount <= 1 || tripCount * bodyCost < minWork) {
+      reject(v, fmt::format("estimated work ({} iterations x {}) below threshold ({})",
+                            tripCount, bodyCost, minWork));
+      return;
+    }
+  } else {
+    minTrips = (minWork + bodyCost - 1) / bodyCost;
+  }
+
+  auto makeSchedule = [&]() {
+    return la.irregular ? std::make_unique<OMPSched>("dynamic")
+                        : std::make_unique<OMPSched>();
+  };
+
+  std::string details = la.irregular ? "dynamic schedule" : "static schedule";
+  if (!reductions.empty()) {
+    std::sort(reductions.begin(), reductions.end());
+    details += fmt::format("; reductions: {}",
+                           fmt::join(reductions.begin(), reductions.end(), ", "));
+  }
+
+  if (minTrips <= 1) {
+    v->setSchedule(makeSchedule());
+    accept(v, details);
+    return;
+  }
+
+  // version the loop on its trip count:
+  //   s = start
+  //   e = end
+  //   if (e - s) >= minTrips * step:
+  //     par_for i in range(s, e, step): body'
+  //   else:
+  //     for i in range(s, e, step): body
+  // where body' uses fresh copies of the private vars
+  auto *series = M->Nr<SeriesFlow>();
+  auto *start = util::makeVar(v->getStart(), series, parent)->getVar();
+  auto *end = util::makeVar(v->getEnd(), series, parent)->getVar();
+  v->setStart(M->Nr<VarValue>(start));
+  v->setEnd(M->Nr<VarValue>(end));
+
+  auto step = v->getStep();
+  auto *span = (step > 0) ? (*M->Nr<VarValue>(end) - *M->Nr<VarValue>(start))
+                          : (*M->Nr<VarValue>(start) - *M->Nr<VarValue>(end));
+  auto *cond = *span >= *M->getInt(minTrips * (step > 0 ? step : -step));
+
+  for (auto &[id, var] : privates) {
+    parent->push_back(var);
+  }
+  util::CloneVisitor cvPar(M), cvSeq(M);
+  auto *parLoop = cast<ImperativeForFlow>(cvPar.clone(v, nullptr, privates));
+  auto *seqLoop = cast<ImperativeForFlow>(cvSeq.clone(v));
+  parLoop->setSchedule(makeSchedule());
+
+  LoopCollector lc(ignored);
+  seqLoop->accept(lc);
+
+  series->push_back(
+      M->Nr<IfFlow>(cond, util::series(parLoop), util::series(seqLoop)));
+  accept(v, details + fmt::format("; guarded by trip count >= {}", minTrips));
+  v->replaceAll(series);
+}
+
+} // namespace parallel
+} // namespace transform
+} // namespace ir
+} // namespace codon
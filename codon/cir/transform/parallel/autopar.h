@@ -0,0 +1,73 @@
+// Copyright (C) 2022-2023 Exaloop Inc. <https://exaloop.io>
+
+#pragma once
+
+#include <unordered_set>
+#include <vector>
+
+#include "codon/cir/transform/pass.h"
+
+namespace codon {
+namespace ir {
+namespace transform {
+namespace parallel {
+
+/// Pass to automatically parallelize loops over ranges whose iterations
+/// are provably independent. Loops are only marked as parallel here; the
+/// actual transformation is done by OpenMPPass, so this pass must run
+/// before it. Loops whose trip count is not known statically are
+/// versioned on a runtime check of the trip count.
+class AutoParallelizationPass : public OperatorPass {
+public:
+  /// Report entry for a single loop
+  struct LoopReport {
+    /// source information of the loop
+    SrcInfo src;
+    /// true if the loop was parallelized
+    bool parallelized;
+    /// reason for the decision
+    std::string reason;
+  };
+
+private:
+  /// key of the side effect analysis
+  std::string sideEffectsKey;
+  /// minimum estimated work for a loop to be parallelized
+  int64_t minWork;
+  /// whether to print the report to stderr after running
+  bool printReport;
+  /// loops processed so far
+  std::vector<LoopReport> report;
+  /// loops that should not be considered, e.g. sequential fallbacks
+  std::unordered_set<id_t> ignored;
+
+public:
+  static const std::string KEY;
+
+  /// Constructs an automatic parallelization pass.
+  /// @param sideEffectsKey the side effect analysis' key
+  /// @param minWork minimum estimated loop work, in IR instructions
+  /// @param printReport whether to print a report of processed loops
+  explicit AutoParallelizationPass(const std::string &sideEffectsKey,
+                                   int64_t minWork = 50000, bool printReport = true)
+      : OperatorPass(), sideEffectsKey(sideEffectsKey), minWork(minWork),
+        printReport(printReport), report(), ignored() {}
+
+  std::string getKey() const override { return KEY; }
+  void run(Module *module) override;
+  void handle(ForFlow *v) override;
+  void handle(ImperativeForFlow *v) override;
+
+  /// @return report entries for all processed loops
+  const std::vector<LoopReport> &getReport() const { return report; }
+
+private:
+  bool shouldProcess(Flow *v);
+  void accept(Flow *v, const std::string &reason);
+  void reject(Flow *v, const std::string &reason);
+};
+
+} // namespace parallel
+} // namespace transform
+} // namespace ir
+} // namespace codon
@@ -3,6 +3,7 @@
 #include "openmp.h"
 
 #include <algorithm>
+#include <functional>
 #include <iterator>
 #include <limits>
 #include <unordered_set>
@@ -59,15 +60,63 @@ Value *ptrFromFunc(Func *func) {
   return util::call(rawMethod, {M->Nr<VarValue>(func)});
 }
 
+// size in bytes of the given type, or -1 if not known
+int64_t getTypeSize(types::Type *type);
+
+// alignment in bytes of the given type, or -1 if not known; fields are
+// laid out with natural alignment, so this is the size for primitives and
+// the maximum alignment of the members for records
+int64_t getTypeAlign(types::Type *type) {
+  if (auto *record = cast<types::RecordType>(type)) {
+    int64_t align = 1;
+    for (auto &field : *record) {
+      auto fieldAlign = getTypeAlign(field.getType());
+      if (fieldAlign <= 0)
+        return -1;
+      align = std::max(align, fieldAlign);
+    }
+    return align;
+  }
+  return getTypeSize(type);
+}
+
+int64_t getTypeSize(types::Type *type) {
+  if (isA<types::IntType>(type) || isA<types::FloatType>(type) ||
+      isA<types::PointerType>(type))
+    return 8;
+  if (isA<types::Float32Type>(type))
+    return 4;
+  if (isA<types::BoolType>(type) || isA<types::ByteType>(type))
+    return 1;
+  if (auto *intN = cast<types::IntNType>(type)) {
+    auto len = intN->getLen();
+    return (len == 8 || len == 16 || len == 32 || len == 64) ? len / 8 : -1;
+  }
+  if (auto *record = cast<types::RecordType>(type)) {
+    int64_t size = 0;
+    for (auto &field : *record) {
+      auto fieldSize = getTypeSize(field.getType());
+      auto fieldAlign = getTypeAlign(field.getType());
+      if (fieldSize < 0 || fieldAlign <= 0)
+        return -1;
+      size = (size + fieldAlign - 1) / fieldAlign * fieldAlign + fieldSize;
+    }
+    auto align = getTypeAlign(record);
+    return (size + align - 1) / align * align;
+  }
+  return -1;
+}
+
 // we create the locks lazily to avoid them when they're not needed
 struct ReductionLocks {
   Var *mainLock =
       nullptr; // lock used in calls to _reduce_no_wait and _end_reduce_no_wait
   Var *critLock = nullptr; // lock used in reduction critical sections
+  bool ws = false;         // whether the locks are for the work-stealing runtime
 
   Var *createLock(Module *M) {
-    auto *lockType = M->getOrRealizeType("Lock", {}, ompModule);
-    seqassertn(lockType, "openmp.Lock type not found");
+    auto *lockType = M->getOrRealizeType(ws ? "WSLock" : "Lock", {}, ompModule);
+    seqassertn(lockType, "openmp lock type not found");
     auto *var = M->Nr<Var>(lockType, /*global=*/true);
     static int counter = 1;
     var->setName(".omp_lock." + std::to_string(counter++));
@@ -149,7 +198,7 @@ struct Reduction {
       case Kind::MIN:
         return M->getFloat(std::numeric_limits<double>::max());
       case Kind::MAX:
-        return M->getFloat(std::numeric_limits<double>::min());
+        return M->getFloat(std::numeric_limits<double>::lowest());
       default:
         return nullptr;
       }
@@ -168,7 +217,7 @@ struct Reduction {
         value = std::numeric_limits<float>::max();
         break;
       case Kind::MAX:
-        value = std::numeric_limits<float>::min();
+        value = std::numeric_limits<float>::lowest();
         break;
       default:
         return nullptr;
@@ -183,9 +232,68 @@ struct Reduction {
     return init;
   }
 
+  // whether a compare-and-swap loop can be used to perform the reduction;
+  // the value must be aligned to its size, as the atomic is 4 or 8 bytes wide
+  bool canUseCAS() {
+    auto *type = getType();
+    auto size = getTypeSize(type);
+    return (size == 4 || size == 8) && getTypeAlign(type) == size &&
+           (isA<types::FloatType>(type) || isA<types::Float32Type>(type) ||
+            isA<types::RecordType>(type));
+  }
+
+  // whether the reduction can be done atomically without taking a lock
+  bool isLockFree() {
+    auto *M = shared->getModule();
+    auto *type = getType();
+    if (isA<types::IntType>(type) || canUseCAS())
+      return true;
+    auto method = getAtomicMethodName();
+    auto *ptrType = M->getPointerType(type);
+    return !method.empty() && M->getOrRealizeMethod(type, method, {ptrType, type});
+  }
+
+  std::string getAtomicMethodName() {
+    switch (kind) {
+    case Kind::ADD:
+      return "__atomic_add__";
+    case Kind::MUL:
+      return "__atomic_mul__";
+    case Kind::AND:
+      return "__atomic_and__";
+    case Kind::OR:
+      return "__atomic_or__";
+    case Kind::XOR:
+      return "__atomic_xor__";
+    case Kind::MIN:
+      return "__atomic_min__";
+    case Kind::MAX:
+      return "__atomic_max__";
+    default:
+      return "";
+    }
+  }
+
+  BodiedFunc *makeCombineFunc() {
+    auto *M = shared->getModule();
+    auto *type = getType();
+    auto *funcType = M->getFuncType(type, {type, type});
+    auto *combiner = M->Nr<BodiedFunc>("__omp_combine");
+    combiner->realize(funcType, {"lhs", "rhs"});
+
+    auto *lhs = M->Nr<VarValue>(combiner->arg_front());
+    auto *rhs = M->Nr<VarValue>(combiner->arg_back());
+    combiner->setBody(util::series(M->Nr<ReturnInstr>(generateCombine(lhs, rhs))));
+    return combiner;
+  }
+
   Value *generateNonAtomicReduction(Value *ptr, Value *arg) {
-    auto *M = ptr->getModule();
-    Value *lhs = util::ptrLoad(ptr);
+    auto *result = generateCombine(util::ptrLoad(ptr), arg);
+    return result ? util::ptrStore(ptr, result) : nullptr;
+  }
+
+  Value *generateCombine(Value *lhs, Value *arg) {
+    auto *M = lhs->getModule();
     Value *result = nullptr;
     switch (kind) {
     case Kind::ADD:
@@ -218,7 +326,7 @@ struct Reduction {
     default:
       return nullptr;
     }
-    return util::ptrStore(ptr, result);
+    return result;
   }
 
   Value *generateAtomicReduction(Value *ptr, Value *arg, Var *loc, Var *gtid,
@@ -253,40 +361,6 @@ struct Reduction {
       default:
         break;
       }
-    } else if (isA<types::FloatType>(type)) {
-      switch (kind) {
-      case Kind::ADD:
-        func = "_atomic_float_add";
-        break;
-      case Kind::MUL:
-        func = "_atomic_float_mul";
-        break;
-      case Kind::MIN:
-        func = "_atomic_float_min";
-        break;
-      case Kind::MAX:
-        func = "_atomic_float_max";
-        break;
-      default:
-        break;
-      }
-    } else if (isA<types::Float32Type>(type)) {
-      switch (kind) {
-      case Kind::ADD:
-        func = "_atomic_float32_add";
-        break;
-      case Kind::MUL:
-        func = "_atomic_float32_mul";
-        break;
-      case Kind::MIN:
-        func = "_atomic_float32_min";
-        break;
-      case Kind::MAX:
-        func = "_atomic_float32_max";
-        break;
-      default:
-        break;
-      }
     }
 
     if (!func.empty()) {
@@ -296,32 +370,7 @@ struct Reduction {
       return util::call(atomicOp, {ptr, arg});
     }
 
-    switch (kind) {
-    case Kind::ADD:
-      func = "__atomic_add__";
-      break;
-    case Kind::MUL:
-      func = "__atomic_mul__";
-      break;
-    case Kind::AND:
-      func = "__atomic_and__";
-      break;
-    case Kind::OR:
-      func = "__atomic_or__";
-      break;
-    case Kind::XOR:
-      func = "__atomic_xor__";
-      break;
-    case Kind::MIN:
-      func = "__atomic_min__";
-      break;
-    case Kind::MAX:
-      func = "__atomic_max__";
-      break;
-    default:
-      break;
-    }
-
+    func = getAtomicMethodName();
     if (!func.empty()) {
       auto *atomicOp =
           M->getOrRealizeMethod(arg->getType(), func, {ptr->getType(), arg->getType()});
@@ -329,9 +378,36 @@ struct Reduction {
         return util::call(atomicOp, {ptr, arg});
     }
 
-    seqassertn(loc && gtid, "loc and/or gtid are null");
+    // floats and small records can be updated with a compare-and-swap loop
+    if (canUseCAS()) {
+      auto *combiner = makeCombineFunc();
+      auto *cas = M->getOrRealizeFunc(
+          "_atomic_cas", {ptr->getType(), arg->getType(), combiner->getType()}, {},
+          ompModule);
+      seqassertn(cas, "compare-and-swap function not found");
+      return util::call(cas, {ptr, arg, M->Nr<VarValue>(combiner)});
+    }
+
     auto *lck = locks.getCritLock(M);
     auto *lckPtrType = M->getPointerType(lck->getType());
+
+    // work-stealing threads don't have OpenMP gtids, so take the lock directly
+    if (locks.ws) {
+      auto *acquire =
+          M->getOrRealizeFunc("_ws_lock_acquire", {lckPtrType}, {}, ompModule);
+      seqassertn(acquire, "lock acquire function not found");
+      auto *release =
+          M->getOrRealizeFunc("_ws_lock_release", {lckPtrType}, {}, ompModule);
+      seqassertn(release, "lock release function not found");
+
+      auto *lockEnter = util::call(acquire, {M->Nr<PointerValue>(lck)});
+      auto *operation = generateNonAtomicReduction(ptr, arg);
+      auto *lockExit = util::call(release, {M->Nr<PointerValue>(lck)});
+      return util::series(lockEnter, M->Nr<TryCatchFlow>(util::series(operation),
+                                                         util::series(lockExit)));
+    }
+
+    seqassertn(loc && gtid, "loc and/or gtid are null");
     auto *critBegin = M->getOrRealizeFunc("_critical_begin",
                                           {loc->getType(), gtid->getType(), lckPtrType},
                                           {}, ompModule);
@@ -520,12 +596,119 @@ struct ReductionIdentifier : public util::Operator {
   }
 };
 
+struct Collection {
+  enum Kind {
+    NONE,
+    LIST,
+    DICT,
+    SET,
+  };
+
+  Kind kind = Kind::NONE;
+  Var *shared = nullptr;
+
+  static Kind getKind(types::Type *type) {
+    auto name = type->getName();
+    if (name.rfind("std.internal.types.ptr.List[", 0) == 0)
+      return Kind::LIST;
+    if (name.rfind("std.internal.types.collections.dict.Dict[", 0) == 0)
+      return Kind::DICT;
+    if (name.rfind("std.internal.types.collections.set.Set[", 0) == 0)
+      return Kind::SET;
+    return Kind::NONE;
+  }
+
+  operator bool() const { return kind != Kind::NONE; }
+};
+
+// identifies collections that the loop body only ever appends/inserts
+// to, which can be built up in thread-local buffers and merged afterwards
+struct CollectionIdentifier : public util::Operator {
+  std::vector<Var *> candidates;
+  std::unordered_map<id_t, unsigned> uses;    // all uses of each candidate
+  std::unordered_map<id_t, unsigned> inserts; // uses as an append/insert receiver
+
+  CollectionIdentifier() : util::Operator(), candidates(), uses(), inserts() {}
+
+  explicit CollectionIdentifier(std::vector<Var *> candidates)
+      : util::Operator(), candidates(std::move(candidates)), uses(), inserts() {}
+
+  Var *getCandidate(Value *v) {
+    auto *var = util::getVar(v);
+    if (!var)
+      return nullptr;
+    for (auto *c : candidates) {
+      if (c->getId() == var->getId())
+        return c;
+    }
+    return nullptr;
+  }
+
+  Collection getCollection(Var *var) {
+    auto kind = Collection::getKind(var->getType());
+    if (!kind)
+      return {};
+    auto it = inserts.find(var->getId());
+    if (it == inserts.end() || it->second != uses[var->getId()])
+      return {};
+    return {kind, var};
+  }
+
+  void handle(VarValue *v) override {
+    if (auto *var = getCandidate(v))
+      ++uses[var->getId()];
+  }
+
+  void handle(PointerValue *v) override {
+    for (auto *c : candidates) {
+      if (c->getId() == v->getVar()->getId())
+        ++uses[c->getId()];
+    }
+  }
+
+  void handle(CallInstr *v) override {
+    auto *func = util::getFunc(v->getCallee());
+    if (!func || v->numArgs() == 0)
+      return;
+    auto *var = getCandidate(v->front());
+    if (!var)
+      return;
+
+    auto name = func->getUnmangledName();
+    bool insert = false;
+    switch (Collection::getKind(var->getType())) {
+    case Collection::Kind::LIST:
+      insert = (name == "append" && v->numArgs() == 2);
+      break;
+    case Collection::Kind::DICT:
+      insert = (name == Module::SETITEM_MAGIC_NAME && v->numArgs() == 3);
+      break;
+    case Collection::Kind::SET:
+      insert = (name == "add" && v->numArgs() == 2);
+      break;
+    default:
+      break;
+    }
+
+    if (insert)
+      ++inserts[var->getId()];
+  }
+};
+
 struct SharedInfo {
   unsigned memb;       // member index in template's `extra` arg
   Var *local;          // the local var we create to store current value
   Reduction reduction; // the reduction we're performing, or empty if none
 };
 
+struct CollectionInfo {
+  unsigned memb;         // member index in template's `extra` arg
+  unsigned registry;     // member index of the buffer registry, if keeping order
+  Var *local;            // the thread-local buffer
+  Var *marks;            // iteration marks if keeping order, or null if not
+  Collection collection; // the collection being built up
+};
+
 struct LoopTemplateReplacer : public util::Operator {
   BodiedFunc *parent;
   CallInstr *replacement;
@@ -544,9 +727,11 @@ struct ParallelLoopTemplateReplacer : public LoopTemplateReplacer {
   Var *gtid;
 
   ParallelLoopTemplateReplacer(BodiedFunc *parent, CallInstr *replacement, Var *loopVar,
-                               ReductionIdentifier *reds)
+                               ReductionIdentifier *reds, bool ws = false)
       : LoopTemplateReplacer(parent, replacement, loopVar), reds(reds), sharedInfo(),
-        locks(), locRef(nullptr), reductionLocRef(nullptr), gtid(nullptr) {}
+        locks(), locRef(nullptr), reductionLocRef(nullptr), gtid(nullptr) {
+    locks.ws = ws;
+  }
 
   unsigned numReductions() {
     unsigned num = 0;
@@ -621,6 +806,22 @@ struct ParallelLoopTemplateReplacer : public LoopTemplateReplacer {
 
       auto *M = parent->getModule();
       auto *extras = util::getVar(v->front());
+
+      // work-stealing tasks combine their partial results as they finish
+      if (locks.ws) {
+        auto *series = M->Nr<SeriesFlow>();
+        for (auto &info : sharedInfo) {
+          if (info.reduction) {
+            Value *ptr = util::tupleGet(M->Nr<VarValue>(extras), info.memb);
+            Value *arg = M->Nr<VarValue>(info.local);
+            series->push_back(
+                info.reduction.generateAtomicReduction(ptr, arg, locRef, gtid, locks));
+          }
+        }
+        v->replaceAll(series);
+        return;
+      }
+
       auto *reductionTuple = getReductionTuple();
       auto *reducer = makeReductionFunc();
       auto *lck = locks.getMainLock(M);
@@ -639,10 +840,23 @@ struct ParallelLoopTemplateReplacer : public LoopTemplateReplacer {
       seqassertn(reduceNoWaitEnd, "end reduce nowait function not found");
 
       auto *series = M->Nr<SeriesFlow>();
+
+      // if a reduction can't be done atomically without taking a lock, keep
+      // the runtime from choosing the atomic method so that the threads'
+      // partial results are combined in a tree rather than one at a time
+      Var *redLoc = reductionLocRef;
+      if (!std::all_of(sharedInfo.begin(), sharedInfo.end(), [](auto &info) {
+            return !info.reduction || info.reduction.isLockFree();
+          })) {
+        auto *treeLoc = M->getOrRealizeFunc("_tree_reduction_loc", {}, {}, ompModule);
+        seqassertn(treeLoc, "tree reduction loc function not found");
+        redLoc = util::makeVar(util::call(treeLoc, {}), series, parent)->getVar();
+      }
+
       auto *tupleVal = util::makeVar(reductionTuple, series, parent);
       auto *reduceCode = util::call(
-          reduceNoWait, {M->Nr<VarValue>(reductionLocRef), M->Nr<VarValue>(gtid),
-                         tupleVal, rawReducer, M->Nr<PointerValue>(lck)});
+          reduceNoWait, {M->Nr<VarValue>(redLoc), M->Nr<VarValue>(gtid), tupleVal,
+                         rawReducer, M->Nr<PointerValue>(lck)});
       auto *codeVar = util::makeVar(reduceCode, series, parent)->getVar();
       seqassertn(codeVar->getType()->is(M->getIntType()), "wrong reduce code type");
 
@@ -657,9 +871,9 @@ struct ParallelLoopTemplateReplacer : public LoopTemplateReplacer {
               info.reduction.generateNonAtomicReduction(ptr, arg));
         }
       }
-      sectionNonAtomic->push_back(util::call(
-          reduceNoWaitEnd, {M->Nr<VarValue>(reductionLocRef), M->Nr<VarValue>(gtid),
-                            M->Nr<PointerValue>(lck)}));
+      sectionNonAtomic->push_back(
+          util::call(reduceNoWaitEnd, {M->Nr<VarValue>(redLoc), M->Nr<VarValue>(gtid),
+                                       M->Nr<PointerValue>(lck)}));
 
       for (auto &info : sharedInfo) {
         if (info.reduction) {
@@ -684,17 +898,69 @@ struct ParallelLoopTemplateReplacer : public LoopTemplateReplacer {
 struct ImperativeLoopTemplateReplacer : public ParallelLoopTemplateReplacer {
   OMPSched *sched;
   int64_t step;
+  CollectionIdentifier *colls;
+  std::unordered_map<id_t, unsigned> registries;
+  std::vector<CollectionInfo> collectionInfo;
+  Flow *bodyLoop; // the template's loop that runs the body, for vectorization
+  int runArg; // index of the adaptive run in the extra args, or -1 if not adaptive
 
   ImperativeLoopTemplateReplacer(BodiedFunc *parent, CallInstr *replacement,
                                  Var *loopVar, ReductionIdentifier *reds,
-                                 OMPSched *sched, int64_t step)
-      : ParallelLoopTemplateReplacer(parent, replacement, loopVar, reds), sched(sched),
-        step(step) {}
+                                 OMPSched *sched, int64_t step,
+                                 CollectionIdentifier *colls,
+                                 std::unordered_map<id_t, unsigned> registries,
+                                 bool ws = false)
+      : ParallelLoopTemplateReplacer(parent, replacement, loopVar, reds, ws),
+        sched(sched), step(step), colls(colls), registries(std::move(registries)),
+        collectionInfo(), bodyLoop(nullptr), runArg(-1) {}
+
+  // merge each thread's buffers into the shared collections, or hand
+  // them over to the registries if order is to be kept
+  void mergeCollections(CallInstr *v) {
+    if (collectionInfo.empty())
+      return;
+    seqassertn(locRef && gtid, "bad visit order in template");
+    seqassertn(v->numArgs() == 1 && isA<VarValue>(v->front()),
+               "unexpected shared updates stub");
+
+    auto *M = parent->getModule();
+    auto *extras = util::getVar(v->front());
+    auto *lck = locks.getCritLock(M);
+    auto *lckPtrType = M->getPointerType(lck->getType());
+    auto *series = M->Nr<SeriesFlow>();
+
+    for (auto &info : collectionInfo) {
+      Value *target = nullptr;
+      Value *buf = M->Nr<VarValue>(info.local);
+      std::string name;
+      if (info.marks) {
+        name = "_collect_deposit";
+        target = util::tupleGet(M->Nr<VarValue>(extras), info.registry);
+        buf = util::makeTuple({buf, M->Nr<VarValue>(info.marks)}, M);
+      } else {
+        name = (info.collection.kind == Collection::Kind::LIST) ? "_collect_extend"
+                                                                : "_collect_update";
+        target = util::tupleGet(M->Nr<VarValue>(extras), info.memb);
+      }
+
+      auto *merge = M->getOrRealizeFunc(name,
+                                        {locRef->getType(), gtid->getType(),
+                                         lckPtrType, target->getType(), buf->getType()},
+                                        {}, ompModule);
+      seqassertn(merge, "collection merge function '{}' not found", name);
+      series->push_back(util::call(merge, {M->Nr<VarValue>(locRef),
+                                           M->Nr<VarValue>(gtid),
+                                           M->Nr<PointerValue>(lck), target, buf}));
+    }
+    insertBefore(series);
+  }
 
   void handle(CallInstr *v) override {
-    ParallelLoopTemplateReplacer::handle(v);
     auto *M = v->getModule();
     auto *func = util::getFunc(v->getCallee());
+    if (func && func->getUnmangledName() == "_loop_reductions")
+      mergeCollections(v);
+    ParallelLoopTemplateReplacer::handle(v);
     if (!func)
       return;
     auto name = func->getUnmangledName();
@@ -746,6 +1012,36 @@ struct ImperativeLoopTemplateReplacer : public ParallelLoopTemplateReplacer {
 
             newArg = M->Nr<PointerValue>(newVar->getVar());
             ++next;
+          } else if (auto collection = colls->getCollection(*outlinedArgs)) {
+            // collections only appended/inserted to get a thread-local buffer
+            auto *body = cast<SeriesFlow>(parent->getBody());
+            Var *lastArg = parent->arg_back();
+            Value *val = util::tupleGet(util::ptrLoad(M->Nr<VarValue>(lastArg)), 3);
+            Value *target = util::tupleGet(val, next);
+
+            auto *bufferFunc = M->getOrRealizeFunc(
+                "_collect_buffer", {target->getType()}, {}, ompModule);
+            seqassertn(bufferFunc, "collection buffer function not found");
+            Var *local = util::makeVar(util::call(bufferFunc, {target}), body, parent,
+                                       /*prepend=*/true)
+                             ->getVar();
+
+            Var *marks = nullptr;
+            unsigned registry = 0;
+            auto it = registries.find((*outlinedArgs)->getId());
+            if (it != registries.end()) {
+              auto *marksFunc =
+                  M->getOrRealizeFunc("_collect_marks", {}, {}, ompModule);
+              seqassertn(marksFunc, "collection marks function not found");
+              marks = util::makeVar(util::call(marksFunc, {}), body, parent,
+                                    /*prepend=*/true)
+                          ->getVar();
+              registry = it->second;
+            }
+
+            collectionInfo.push_back({next, registry, local, marks, collection});
+            newArg = M->Nr<VarValue>(local);
+            ++next;
           } else {
             newArg = util::tupleGet(M->Nr<VarValue>(extras), next++);
           }
@@ -764,7 +1060,36 @@ struct ImperativeLoopTemplateReplacer : public ParallelLoopTemplateReplacer {
         ++outlinedArgs;
       }
 
-      v->replaceAll(util::call(outlinedFunc, newArgs));
+      Value *bodyCall = util::call(outlinedFunc, newArgs);
+      // record which iterations produced which buffered items
+      if (std::any_of(collectionInfo.begin(), collectionInfo.end(),
+                      [](auto &info) { return info.marks != nullptr; })) {
+        auto *series = util::series(bodyCall);
+        for (auto &info : collectionInfo) {
+          if (!info.marks)
+            continue;
+          auto *items = M->Nr<VarValue>(info.local);
+          auto *marks = M->Nr<VarValue>(info.marks);
+          auto *markFunc = M->getOrRealizeFunc(
+              "_collect_mark", {items->getType(), marks->getType(), M->getIntType()},
+              {}, ompModule);
+          seqassertn(markFunc, "collection mark function not found");
+          series->push_back(
+              util::call(markFunc, {items, marks, M->Nr<VarValue>(newLoopVar)}));
+        }
+        bodyCall = series;
+      }
+
+      for (auto it = parent_end(); it != parent_begin();) {
+        auto *node = *--it;
+        if (isA<WhileFlow>(node) || isA<ForFlow>(node) ||
+            isA<ImperativeForFlow>(node)) {
+          bodyLoop = cast<Flow>(node);
+          break;
+        }
+      }
+
+      v->replaceAll(bodyCall);
       replacement = nullptr;
     }
 
@@ -796,6 +1121,12 @@ struct ImperativeLoopTemplateReplacer : public ParallelLoopTemplateReplacer {
     if (name == "_loop_ordered") {
       v->replaceAll(M->getBool(sched->ordered));
     }
+
+    if (name == "_loop_adaptive_run") {
+      seqassertn(runArg >= 0, "unexpected adaptive run stub");
+      auto *extras = util::getVar(v->front());
+      v->replaceAll(util::tupleGet(M->Nr<VarValue>(extras), runArg));
+    }
   }
 };
 
@@ -849,9 +1180,55 @@ struct TaskLoopReductionVarReplacer : public util::Operator {
 struct TaskLoopBodyStubReplacer : public util::Operator {
   CallInstr *replacement;
   std::vector<bool> reduceArgs;
+  std::vector<Reduction> reductions; // reductions of reduce args, if work-stealing
+  ReductionLocks *locks;             // locks if work-stealing, or null if not
+
+  TaskLoopBodyStubReplacer(CallInstr *replacement, std::vector<bool> reduceArgs,
+                           std::vector<Reduction> reductions = {},
+                           ReductionLocks *locks = nullptr)
+      : util::Operator(), replacement(replacement), reduceArgs(std::move(reduceArgs)),
+        reductions(std::move(reductions)), locks(locks) {}
+
+  // Work-stealing tasks reduce into a local value, which is combined
+  // atomically with the shared one once the iteration is done.
+  void replaceWithPartials(CallInstr *v, Value *privatesTuple, Value *sharedsTuple) {
+    auto *M = v->getModule();
+    auto *routine = cast<BodiedFunc>(getParentFunc());
+    auto *series = M->Nr<SeriesFlow>();
+    auto *sharedsVar = util::getVar(sharedsTuple);
+    unsigned privatesNext = 0;
+    unsigned sharedsNext = 0;
+    unsigned i = 0;
+    std::vector<Value *> newArgs;
+    std::vector<SharedInfo> partials;
+
+    for (auto *arg : *replacement) {
+      if (isA<VarValue>(arg)) {
+        newArgs.push_back(util::tupleGet(privatesTuple, privatesNext++));
+      } else if (isA<PointerValue>(arg)) {
+        if (reduceArgs[i]) {
+          auto *local = util::getVar(
+              util::makeVar(reductions[i].getInitial(), series, routine));
+          partials.push_back({sharedsNext, local, reductions[i]});
+          newArgs.push_back(M->Nr<PointerValue>(local));
+        } else {
+          newArgs.push_back(util::tupleGet(sharedsTuple, sharedsNext));
+        }
+        ++sharedsNext;
+      } else {
+        seqassertn(false, "unknown outline var");
+      }
+      ++i;
+    }
 
-  TaskLoopBodyStubReplacer(CallInstr *replacement, std::vector<bool> reduceArgs)
-      : util::Operator(), replacement(replacement), reduceArgs(std::move(reduceArgs)) {}
+    series->push_back(util::call(util::getFunc(replacement->getCallee()), newArgs));
+    for (auto &info : partials) {
+      auto *ptr = util::tupleGet(M->Nr<VarValue>(sharedsVar), info.memb);
+      series->push_back(info.reduction.generateAtomicReduction(
+          ptr, M->Nr<VarValue>(info.local), nullptr, nullptr, *locks));
+    }
+    v->replaceAll(series);
+  }
 
   void handle(CallInstr *v) override {
     auto *func = util::getFunc(v->getCallee());
@@ -866,6 +1243,13 @@ struct TaskLoopBodyStubReplacer : public util::Operator {
       auto *gtid = args[0];
       auto *privatesTuple = args[1];
       auto *sharedsTuple = args[2];
+
+      if (locks) {
+        replaceWithPartials(v, privatesTuple, sharedsTuple);
+        replacement = nullptr;
+        return;
+      }
+
       unsigned privatesNext = 0;
       unsigned sharedsNext = 0;
       std::vector<Value *> newArgs;
@@ -912,6 +1296,8 @@ struct TaskLoopRoutineStubReplacer : public ParallelLoopTemplateReplacer {
   std::vector<Value *> shareds;
   Var *array;  // task reduction input array
   Var *tskgrp; // task group identifier
+  // private lists whose order is kept, mapped to their batch buffer index
+  std::unordered_map<unsigned, unsigned> buffered;
 
   void setupSharedInfo(std::vector<Reduction> &sharedRedux) {
     unsigned sharedsNext = 0;
@@ -931,10 +1317,12 @@ struct TaskLoopRoutineStubReplacer : public ParallelLoopTemplateReplacer {
   TaskLoopRoutineStubReplacer(BodiedFunc *parent, CallInstr *replacement, Var *loopVar,
                               ReductionIdentifier *reds, std::vector<Value *> privates,
                               std::vector<Value *> shareds,
-                              std::vector<Reduction> sharedRedux)
-      : ParallelLoopTemplateReplacer(parent, replacement, loopVar, reds),
+                              std::vector<Reduction> sharedRedux,
+                              std::unordered_map<unsigned, unsigned> buffered,
+                              bool ws = false)
+      : ParallelLoopTemplateReplacer(parent, replacement, loopVar, reds, ws),
         privates(std::move(privates)), shareds(std::move(shareds)), array(nullptr),
-        tskgrp(nullptr) {
+        tskgrp(nullptr), buffered(std::move(buffered)) {
     setupSharedInfo(sharedRedux);
   }
 
@@ -988,12 +1376,15 @@ struct TaskLoopRoutineStubReplacer : public ParallelLoopTemplateReplacer {
   void handle(VarValue *v) override {
     auto *M = v->getModule();
     auto *func = util::getFunc(v);
-    if (func && func->getUnmangledName() == "_routine_stub") {
+    if (func && (func->getUnmangledName() == "_routine_stub" ||
+                 func->getUnmangledName() == "_batch_routine_stub")) {
       std::vector<bool> reduceArgs;
+      std::vector<Reduction> reductions;
       unsigned sharedsNext = 0;
       unsigned infoNext = 0;
 
       for (auto *arg : *replacement) {
+        reductions.emplace_back();
         if (isA<VarValue>(arg)) {
           reduceArgs.push_back(false);
         } else if (isA<PointerValue>(arg)) {
@@ -1001,6 +1392,7 @@ struct TaskLoopRoutineStubReplacer : public ParallelLoopTemplateReplacer {
               sharedInfo[infoNext].memb == sharedsNext &&
               sharedInfo[infoNext].reduction) {
             reduceArgs.push_back(true);
+            reductions.back() = sharedInfo[infoNext].reduction;
             ++infoNext;
           } else {
             reduceArgs.push_back(false);
@@ -1017,7 +1409,8 @@ struct TaskLoopRoutineStubReplacer : public ParallelLoopTemplateReplacer {
 
       util::CloneVisitor cv(M);
       auto *newRoutine = cv.forceClone(func);
-      TaskLoopBodyStubReplacer rep(replacement, reduceArgs);
+      TaskLoopBodyStubReplacer rep(replacement, reduceArgs, reductions,
+                                   locks.ws ? &locks : nullptr);
       newRoutine->accept(rep);
       v->setVar(newRoutine);
     }
@@ -1087,11 +1480,12 @@ struct TaskLoopRoutineStubReplacer : public ParallelLoopTemplateReplacer {
 
     if (name == "_fix_privates_and_shareds") {
       std::vector<Value *> args(v->begin(), v->end());
-      seqassertn(args.size() == 3, "invalid _fix_privates_and_shareds call found");
+      seqassertn(args.size() == 4, "invalid _fix_privates_and_shareds call found");
       unsigned numRed = numReductions();
       auto *newLoopVar = args[0];
       auto *privatesTuple = args[1];
       auto *sharedsTuple = args[2];
+      auto *buffers = args[3];
 
       unsigned privatesNext = 0;
       unsigned sharedsNext = 0;
@@ -1104,10 +1498,14 @@ struct TaskLoopRoutineStubReplacer : public ParallelLoopTemplateReplacer {
       std::vector<Value *> newShareds;
 
       for (auto *val : privates) {
-        if (numRed > 0 && val == privates.back()) { // i.e. task group identifier
+        if (!locks.ws && numRed > 0 &&
+            val == privates.back()) { // i.e. task group identifier
           seqassertn(tskgrp, "tskgrp var not set");
           newPrivates.push_back(M->Nr<VarValue>(tskgrp));
           needNewPrivates = true;
+        } else if (buffered.count(privatesNext)) {
+          newPrivates.push_back(util::tupleGet(buffers, buffered[privatesNext]));
+          needNewPrivates = true;
         } else if (getVarFromOutlinedArg(val)->getId() != loopVar->getId()) {
           newPrivates.push_back(util::tupleGet(privatesTuple, privatesNext));
         } else {
@@ -1225,11 +1623,12 @@ struct OpenMPTransformData {
   util::OutlineResult outline;
   std::vector<Var *> sharedVars;
   ReductionIdentifier reds;
+  CollectionIdentifier colls;
 };
 
 template <typename T> OpenMPTransformData unpar(T *v) {
   v->setParallel(false);
-  return {{}, {}, {}};
+  return {{}, {}, {}, {}};
 }
 
 template <typename T>
@@ -1251,6 +1650,7 @@ OpenMPTransformData setupOpenMPTransform(T *v, BodiedFunc *parent, bool gpu) {
 
   // shared argument vars
   std::vector<Var *> sharedVars;
+  std::vector<Var *> collectionVars;
   Var *loopVarArg = nullptr;
   unsigned i = 0;
   for (auto it = outline.func->arg_begin(); it != outline.func->arg_end(); ++it) {
@@ -1258,14 +1658,19 @@ OpenMPTransformData setupOpenMPTransform(T *v, BodiedFunc *parent, bool gpu) {
     // ensure we don't reduce over it
     if (getVarFromOutlinedArg(outlineCallArgs[i])->getId() == loopVar->getId())
       loopVarArg = *it;
+    else if (!gpu && outline.argKinds[i] == util::OutlineResult::ArgKind::CONSTANT &&
+             Collection::getKind((*it)->getType()))
+      collectionVars.push_back(*it);
     if (outline.argKinds[i] == util::OutlineResult::ArgKind::MODIFIED)
       sharedVars.push_back(*it);
     ++i;
   }
   ReductionIdentifier reds(sharedVars, loopVarArg);
   outline.func->accept(reds);
+  CollectionIdentifier colls(collectionVars);
+  outline.func->accept(colls);
 
-  return {outline, sharedVars, reds};
+  return {outline, sharedVars, reds, colls};
 }
 
 struct ForkCallData {
@@ -1368,6 +1773,8 @@ CollapseResult collapseLoop(BodiedFunc *parent, ImperativeForFlow *v, int64_t le
   sched->collapse = 0;
   auto *collapsed = M->Nr<ImperativeForFlow>(M->getInt(0), 1, numIters, body,
                                              collapsedVar, std::move(sched));
+  if (auto *hints = v->getAttribute<VectorizeAttribute>())
+    collapsed->setAttribute(std::make_unique<VectorizeAttribute>(*hints));
 
   // reconstruct indices by successive divmods
   Var *lastDiv = nullptr;
@@ -1395,6 +1802,38 @@ CollapseResult collapseLoop(BodiedFunc *parent, ImperativeForFlow *v, int64_t le
 
   return res;
 }
+// whether the loop should run on the work-stealing runtime
+bool useWorkStealing(Flow *v, OMPSched *sched, bool byDefault) {
+  if (sched->gpu)
+    return false;
+
+  bool ws = byDefault;
+  if (sched->runtime == "ws") {
+    ws = true;
+  } else if (sched->runtime == "omp") {
+    ws = false;
+  } else if (!sched->runtime.empty()) {
+    warn("unknown parallel runtime '" + sched->runtime + "'; using OpenMP", v);
+    return false;
+  }
+
+  if (ws && sched->ordered) {
+    warn("ordered loops are not supported by the work-stealing runtime; using OpenMP",
+         v);
+    return false;
+  }
+  return ws;
+}
+
+Value *createWorkStealingForkCall(Module *M, Value *rawTemplateFunc, int64_t step,
+                                  const std::vector<Value *> &forkExtraArgs) {
+  auto *forkExtra = util::makeTuple(forkExtraArgs, M);
+  std::vector<types::Type *> forkArgTypes = {rawTemplateFunc->getType(),
+                                             M->getIntType(), forkExtra->getType()};
+  auto *forkFunc = M->getOrRealizeFunc("_ws_fork_call", forkArgTypes, {}, ompModule);
+  seqassertn(forkFunc, "work-stealing fork call function not found");
+  return util::call(forkFunc, {rawTemplateFunc, M->getInt(step), forkExtra});
+}
 } // namespace
 
 const std::string OpenMPPass::KEY = "core-parallel-openmp";
@@ -1407,18 +1846,29 @@ void OpenMPPass::handle(ForFlow *v) {
   auto &outline = data.outline;
   auto &sharedVars = data.sharedVars;
   auto &reds = data.reds;
+  auto &colls = data.colls;
 
   auto *M = v->getModule();
   auto *loopVar = v->getVar();
   auto *sched = v->getSchedule();
+  bool ws = useWorkStealing(v, sched, workStealing);
   OMPTypes types(M);
 
-  // separate arguments into 'private' and 'shared'
+  // separate arguments into 'private' and 'shared'; lists built up in the
+  // loop whose order is to be kept ('targets') get a buffer per batch
   std::vector<Reduction> sharedRedux; // reductions corresponding to shared vars
-  std::vector<Value *> privates, shareds;
+  std::vector<Value *> privates, shareds, targets;
+  std::unordered_map<unsigned, unsigned> buffered;
+  auto outlinedArgs = outline.func->arg_begin();
   unsigned i = 0;
   for (auto *arg : *outline.call) {
+    auto *var = *outlinedArgs++;
     if (isA<VarValue>(arg)) {
+      auto collection = colls.getCollection(var);
+      if (sched->keepOrder && collection && collection.kind == Collection::Kind::LIST) {
+        buffered.emplace(privates.size(), targets.size());
+        targets.push_back(M->Nr<VarValue>(util::getVar(arg)));
+      }
       privates.push_back(arg);
     } else {
       shareds.push_back(arg);
@@ -1432,8 +1882,8 @@ void OpenMPPass::handle(ForFlow *v) {
   // __kmpc_taskred_modifier_init to the task entry, so append
   // it to private data (initially as null void pointer). Also
   // we add an argument to the end of the outlined function for
-  // the gtid.
-  if (reds.reductions.size() > 0) {
+  // the gtid. Work-stealing tasks reduce into locals instead.
+  if (!ws && reds.reductions.size() > 0) {
     auto *nullPtr = types.i8ptr->construct({});
     privates.push_back(nullPtr);
 
@@ -1474,24 +1924,47 @@ void OpenMPPass::handle(ForFlow *v) {
 
   auto *privatesTuple = util::makeTuple(privates, M);
   auto *sharedsTuple = util::makeTuple(shareds, M);
+  auto *targetsTuple = util::makeTuple(targets, M);
+  // iterations per task
+  auto *chunk = (sched->chunk && sched->chunk->getType()->is(types.i64))
+                    ? sched->chunk
+                    : M->getInt(1);
+
+  // the work-stealing template spawns the tasks and waits for them itself
+  if (ws) {
+    auto *extra = util::makeTuple(
+        {chunk, v->getIter(), privatesTuple, sharedsTuple, targetsTuple}, M);
+    auto *templateFunc = M->getOrRealizeFunc("_ws_task_loop_outline_template",
+                                             {extra->getType()}, {}, ompModule);
+    seqassertn(templateFunc, "work-stealing task loop outline template not found");
+
+    templateFunc = cv.forceClone(templateFunc);
+    TaskLoopRoutineStubReplacer rep(cast<BodiedFunc>(templateFunc), outline.call,
+                                    loopVar, &reds, privates, shareds, sharedRedux,
+                                    buffered, /*ws=*/true);
+    templateFunc->accept(rep);
+    v->replaceAll(util::call(templateFunc, {extra}));
+    return;
+  }
 
   // template call
   std::vector<types::Type *> templateFuncArgs = {
       types.i32ptr, types.i32ptr,
-      M->getPointerType(
-          M->getTupleType({v->getIter()->getType(), privatesTuple->getType(),
-                           sharedsTuple->getType()}))};
+      M->getPointerType(M->getTupleType(
+          {chunk->getType(), v->getIter()->getType(), privatesTuple->getType(),
+           sharedsTuple->getType(), targetsTuple->getType()}))};
   auto *templateFunc = M->getOrRealizeFunc("_task_loop_outline_template",
                                            templateFuncArgs, {}, ompModule);
   seqassertn(templateFunc, "task loop outline template not found");
 
   templateFunc = cv.forceClone(templateFunc);
   TaskLoopRoutineStubReplacer rep(cast<BodiedFunc>(templateFunc), outline.call, loopVar,
-                                  &reds, privates, shareds, sharedRedux);
+                                  &reds, privates, shareds, sharedRedux, buffered);
   templateFunc->accept(rep);
   auto *rawTemplateFunc = ptrFromFunc(templateFunc);
 
-  std::vector<Value *> forkExtraArgs = {v->getIter(), privatesTuple, sharedsTuple};
+  std::vector<Value *> forkExtraArgs = {chunk, v->getIter(), privatesTuple,
+                                        sharedsTuple, targetsTuple};
 
   // fork call
   auto forkData = createForkCall(M, types, rawTemplateFunc, forkExtraArgs, sched);
@@ -1524,10 +1997,12 @@ void OpenMPPass::handle(ImperativeForFlow *v) {
   auto &outline = data.outline;
   auto &sharedVars = data.sharedVars;
   auto &reds = data.reds;
+  auto &colls = data.colls;
 
   auto *M = v->getModule();
   auto *loopVar = v->getVar();
   auto *sched = v->getSchedule();
+  bool ws = useWorkStealing(v, sched, workStealing);
   OMPTypes types(M);
 
   // we disable shared vars for GPU loops
@@ -1543,10 +2018,84 @@ void OpenMPPass::handle(ImperativeForFlow *v) {
     }
   }
 
+  // lists built up in the loop whose order is to be kept get a registry
+  // for the threads' buffers, which is merged into the list after the loop
+  std::unordered_map<id_t, unsigned> registries;
+  std::vector<std::pair<Var *, Var *>> orderedLists; // list and registry
+  if (!sched->gpu && sched->keepOrder) {
+    auto *setup = M->Nr<SeriesFlow>();
+    auto outlinedArgs = outline.func->arg_begin();
+    for (auto *arg : *outline.call) {
+      auto *var = *outlinedArgs++;
+      auto collection = colls.getCollection(var);
+      if (!collection || collection.kind != Collection::Kind::LIST)
+        continue;
+
+      auto *target = getVarFromOutlinedArg(arg);
+      auto *registryFunc = M->getOrRealizeFunc("_collect_ordered_registry",
+                                               {target->getType()}, {}, ompModule);
+      seqassertn(registryFunc, "collection registry function not found");
+      auto *registry = util::makeVar(
+          util::call(registryFunc, {M->Nr<VarValue>(target)}), setup, parent);
+      registries.emplace(var->getId(), extraArgs.size());
+      orderedLists.emplace_back(target, registry->getVar());
+      extraArgs.push_back(registry);
+      extraArgTypes.push_back(registry->getType());
+    }
+    if (!orderedLists.empty())
+      insertBefore(setup);
+  }
+
+  // adaptive loops keep a region across executions that chooses their
+  // schedule at runtime
+  Var *region = nullptr;
+  if (sched->adaptive && !sched->gpu && !ws) {
+    auto *regionFunc = M->getOrRealizeFunc(
+        "_adaptive_region", {M->getStringType(), M->getBoolType()}, {}, ompModule);
+    seqassertn(regionFunc, "adaptive region function not found");
+    region = M->Nr<Var>(util::getReturnType(regionFunc), /*global=*/true);
+    static int counter = 1;
+    region->setName(".omp_adaptive." + std::to_string(counter++));
+
+    // initialize it in the main function, like the OpenMP locks
+    auto *series = cast<SeriesFlow>(cast<BodiedFunc>(M->getMainFunc())->getBody());
+    auto *loc = M->getString(fmt::format("{}", v->getSrcInfo()));
+    auto *init = util::call(regionFunc, {loc, M->getBool(sched->ordered)});
+    series->insert(series->begin(), M->Nr<AssignInstr>(region, init));
+  }
+
+  // each execution of an adaptive loop gets its own run, which fixes the
+  // schedule for all threads and collects their timings; the region is
+  // only updated once the run is over
+  Var *run = nullptr, *startVar = nullptr, *stopVar = nullptr;
+  int runArg = -1;
+  if (region) {
+    auto *bounds = M->Nr<SeriesFlow>();
+    startVar = util::makeVar(v->getStart(), bounds, parent)->getVar();
+    stopVar = util::makeVar(v->getEnd(), bounds, parent)->getVar();
+    auto *beginFunc = M->getOrRealizeFunc(
+        "_adaptive_begin", {region->getType(), types.i64, types.i64, types.i64}, {},
+        ompModule);
+    seqassertn(beginFunc, "adaptive begin function not found");
+    auto *runVal = util::makeVar(
+        util::call(beginFunc, {M->Nr<VarValue>(region), M->Nr<VarValue>(startVar),
+                               M->Nr<VarValue>(stopVar), M->getInt(v->getStep())}),
+        bounds, parent);
+    run = runVal->getVar();
+    insertBefore(bounds);
+    runArg = extraArgs.size();
+    extraArgs.push_back(runVal);
+    extraArgTypes.push_back(runVal->getType());
+  }
+
   // template call
   std::string templateFuncName;
   if (sched->gpu) {
     templateFuncName = "_gpu_loop_outline_template";
+  } else if (ws) {
+    templateFuncName = "_ws_loop_outline_template";
+  } else if (region) {
+    templateFuncName = "_adaptive_loop_outline_template";
   } else if (sched->dynamic) {
     templateFuncName = "_dynamic_loop_outline_template";
   } else if (sched->chunk) {
@@ -1598,8 +2147,10 @@ void OpenMPPass::handle(ImperativeForFlow *v) {
     v->replaceAll(util::call(
         templateFunc, {v->getStart(), v->getEnd(), util::makeTuple(extraArgs, M)}));
   } else {
+    // the work-stealing template is passed the range of iterations to run
+    // in place of the bound thread id
     std::vector<types::Type *> templateFuncArgs = {
-        types.i32ptr, types.i32ptr,
+        types.i32ptr, ws ? M->getPointerType(types.i64) : types.i32ptr,
         M->getPointerType(M->getTupleType(
             {types.i64, types.i64, types.i64, M->getTupleType(extraArgTypes)}))};
     auto *templateFunc =
@@ -1609,23 +2160,69 @@ void OpenMPPass::handle(ImperativeForFlow *v) {
     util::CloneVisitor cv(M);
     templateFunc = cast<Func>(cv.forceClone(templateFunc));
     ImperativeLoopTemplateReplacer rep(cast<BodiedFunc>(templateFunc), outline.call,
-                                       loopVar, &reds, sched, v->getStep());
+                                       loopVar, &reds, sched, v->getStep(), &colls,
+                                       registries, ws);
+    rep.runArg = runArg;
     templateFunc->accept(rep);
+    // each thread's share of the iterations is vectorized as requested
+    auto *hints = v->getAttribute<VectorizeAttribute>();
+    if (hints && rep.bodyLoop) {
+      auto copy = std::make_unique<VectorizeAttribute>(*hints);
+      copy->loc = v->getSrcInfo();
+      rep.bodyLoop->setAttribute(std::move(copy));
+    }
     auto *rawTemplateFunc = ptrFromFunc(templateFunc);
 
+    // for work-stealing, the chunk size is the grain size, chosen at runtime
+    // if not given
     auto *chunk = (sched->chunk && sched->chunk->getType()->is(types.i64))
                       ? sched->chunk
-                      : M->getInt(1);
-    std::vector<Value *> forkExtraArgs = {chunk, v->getStart(), v->getEnd()};
+                      : M->getInt(ws ? 0 : 1);
+    // adaptive loops have already evaluated their bounds, to count iterations
+    Value *start = startVar ? M->Nr<VarValue>(startVar) : v->getStart();
+    Value *stop = stopVar ? M->Nr<VarValue>(stopVar) : v->getEnd();
+    std::vector<Value *> forkExtraArgs = {chunk, start, stop};
     for (auto *arg : extraArgs) {
       forkExtraArgs.push_back(arg);
     }
 
     // fork call
-    auto forkData = createForkCall(M, types, rawTemplateFunc, forkExtraArgs, sched);
-    if (forkData.pushNumThreads)
-      insertBefore(forkData.pushNumThreads);
-    v->replaceAll(forkData.fork);
+    Value *fork = nullptr;
+    if (ws) {
+      fork =
+          createWorkStealingForkCall(M, rawTemplateFunc, v->getStep(), forkExtraArgs);
+    } else {
+      auto forkData = createForkCall(M, types, rawTemplateFunc, forkExtraArgs, sched);
+      if (forkData.pushNumThreads)
+        insertBefore(forkData.pushNumThreads);
+      fork = forkData.fork;
+    }
+    if (run) {
+      auto *endFunc =
+          M->getOrRealizeFunc("_adaptive_end", {run->getType()}, {}, ompModule);
+      seqassertn(endFunc, "adaptive end function not found");
+      fork = util::series(fork, util::call(endFunc, {M->Nr<VarValue>(run)}));
+    }
+    if (orderedLists.empty()) {
+      v->replaceAll(fork);
+    } else {
+      auto *series = util::series(fork);
+      auto *lck = rep.locks.getCritLock(M);
+      for (auto &p : orderedLists) {
+        std::vector<Value *> mergeArgs = {
+            M->Nr<VarValue>(p.first), M->Nr<VarValue>(p.second),
+            M->getBool(v->getStep() > 0), M->Nr<PointerValue>(lck)};
+        std::vector<types::Type *> mergeArgTypes;
+        for (auto *mergeArg : mergeArgs) {
+          mergeArgTypes.push_back(mergeArg->getType());
+        }
+        auto *mergeFunc = M->getOrRealizeFunc("_collect_ordered_extend", mergeArgTypes,
+                                              {}, ompModule);
+        seqassertn(mergeFunc, "ordered collection merge function not found");
+        series->push_back(util::call(mergeFunc, mergeArgs));
+      }
+      v->replaceAll(series);
+    }
   }
 }
 
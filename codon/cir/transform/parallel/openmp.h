@@ -10,13 +10,23 @@ namespace transform {
 namespace parallel {
 
 class OpenMPPass : public OperatorPass {
+private:
+  /// whether loops use the work-stealing runtime unless they specify otherwise
+  bool workStealing;
+
 public:
   /// Constructs an OpenMP pass.
-  OpenMPPass() : OperatorPass(/*childrenFirst=*/true) {}
+  /// @param workStealing whether to use the work-stealing runtime by default
+  explicit OpenMPPass(bool workStealing = false)
+      : OperatorPass(/*childrenFirst=*/true), workStealing(workStealing) {}
 
   static const std::string KEY;
   std::string getKey() const override { return KEY; }
 
+  /// Sets whether loops use the work-stealing runtime by default.
+  /// @param ws true to use the work-stealing runtime by default
+  void setWorkStealing(bool ws) { workStealing = ws; }
+
   void handle(ForFlow *) override;
   void handle(ImperativeForFlow *) override;
 };
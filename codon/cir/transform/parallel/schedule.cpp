@@ -7,6 +7,7 @@
 
 #include <cctype>
 #include <sstream>
+#include <utility>
 
 namespace codon {
 namespace ir {
@@ -50,18 +51,24 @@ Value *nullIfNeg(Value *v) {
 } // namespace
 
 OMPSched::OMPSched(int code, bool dynamic, Value *threads, Value *chunk, bool ordered,
-                   int64_t collapse, bool gpu)
+                   int64_t collapse, bool gpu, bool keepOrder, std::string runtime)
     : code(code), dynamic(dynamic), threads(nullIfNeg(threads)),
-      chunk(nullIfNeg(chunk)), ordered(ordered), collapse(collapse), gpu(gpu) {
+      chunk(nullIfNeg(chunk)), ordered(ordered), collapse(collapse), gpu(gpu),
+      keepOrder(keepOrder), runtime(std::move(runtime)), adaptive(false) {
   if (code < 0)
     this->code = getScheduleCode();
 }
 
 OMPSched::OMPSched(const std::string &schedule, Value *threads, Value *chunk,
-                   bool ordered, int64_t collapse, bool gpu)
-    : OMPSched(getScheduleCode(schedule, nullIfNeg(chunk) != nullptr, ordered),
+                   bool ordered, int64_t collapse, bool gpu, bool keepOrder,
+                   std::string runtime)
+    : OMPSched(getScheduleCode(schedule == "adaptive" ? "dynamic" : schedule,
+                               nullIfNeg(chunk) != nullptr, ordered),
                (schedule != "static") || ordered, threads, chunk, ordered, collapse,
-               gpu) {}
+               gpu, keepOrder, std::move(runtime)) {
+  // adaptive loops fall back to dynamic scheduling where they can't adapt
+  adaptive = (schedule == "adaptive");
+}
 
 std::vector<Value *> OMPSched::getUsedValues() const {
   std::vector<Value *> ret;
@@ -20,16 +20,22 @@ struct OMPSched {
   bool ordered;
   int64_t collapse;
   bool gpu;
+  bool keepOrder;
+  std::string runtime; // "omp", "ws" or empty for the default
+  bool adaptive;       // schedule kind and chunk size chosen at runtime
 
   explicit OMPSched(int code = -1, bool dynamic = false, Value *threads = nullptr,
                     Value *chunk = nullptr, bool ordered = false, int64_t collapse = 0,
-                    bool gpu = false);
+                    bool gpu = false, bool keepOrder = false,
+                    std::string runtime = "");
   explicit OMPSched(const std::string &code, Value *threads = nullptr,
                     Value *chunk = nullptr, bool ordered = false, int64_t collapse = 0,
-                    bool gpu = false);
+                    bool gpu = false, bool keepOrder = false,
+                    std::string runtime = "");
   OMPSched(const OMPSched &s)
       : code(s.code), dynamic(s.dynamic), threads(s.threads), chunk(s.chunk),
-        ordered(s.ordered), collapse(s.collapse), gpu(s.gpu) {}
+        ordered(s.ordered), collapse(s.collapse), gpu(s.gpu), keepOrder(s.keepOrder),
+        runtime(s.runtime), adaptive(s.adaptive) {}
 
   std::vector<Value *> getUsedValues() const;
   int replaceUsedValue(id_t id, Value *newValue);
@@ -0,0 +1,224 @@
+// Copyright (C) 2022-2023 Exaloop Inc. <https://exaloop.io>
+
+#include "devirtualize.h"
+
+#include <algorithm>
+
+#include "codon/cir/util/cloning.h"
+#include "codon/cir/util/inlining.h"
+#include "codon/cir/util/irtools.h"
+#include "codon/cir/util/matching.h"
+#include "codon/parser/cache.h"
+
+namespace codon {
+namespace ir {
+namespace transform {
+namespace polymorphism {
+namespace {
+/// Virtual call metadata
+struct VirtualCall {
+  /// the object whose vtable is used
+  Value *obj = nullptr;
+  /// the vtable slot load, i.e. vtable[id]
+  Value *slot = nullptr;
+  /// the vtable slot index
+  int64_t id = 0;
+
+  operator bool() const { return slot != nullptr; }
+};
+
+/// Checks if the given value can be evaluated more than once
+/// or not at all without changing program behavior.
+bool isSimple(Value *v) {
+  if (isA<VarValue>(v))
+    return true;
+  if (auto *e = cast<ExtractInstr>(v))
+    return isSimple(e->getVal());
+  return false;
+}
+
+/// Identify a virtual call and return its metadata. Virtual calls
+/// are generated by the type checker and have the form:
+///   Function[T, R](__internal__.class_get_rtti_vtable(obj)[id])(obj, ...)
+/// @param v the call
+/// @return the metadata
+VirtualCall analyzeVirtualCall(CallInstr *v) {
+  auto *fnNew = cast<CallInstr>(v->getCallee());
+  if (!fnNew || !util::isCallOf(fnNew, Module::NEW_MAGIC_NAME, 1))
+    return {};
+
+  auto *slot = cast<CallInstr>(fnNew->front());
+  if (!slot || !util::isCallOf(slot, Module::GETITEM_MAGIC_NAME, 2) ||
+      !util::isConst<int64_t>(slot->back()))
+    return {};
+
+  auto *vtable = cast<CallInstr>(slot->front());
+  if (!vtable || !util::isCallOf(vtable, "class_get_rtti_vtable", 1))
+    return {};
+
+  // object must be the same as the 'self' argument, and must be
+  // simple since we might drop its evaluation in the vtable lookup
+  auto *obj = vtable->front();
+  if (v->numArgs() == 0 || !isSimple(obj) ||
+      !util::match(obj, v->front(), /*checkNames=*/false, /*varIdMatch=*/true))
+    return {};
+
+  return {obj, slot, util::getConst<int64_t>(slot->back())};
+}
+
+Func *getIRFunc(ast::Cache *cache, const ast::types::FuncTypePtr &fn) {
+  if (!fn || !fn->ast)
+    return nullptr;
+  auto it = cache->functions.find(fn->ast->name);
+  if (it == cache->functions.end())
+    return nullptr;
+  auto jt = it->second.realizations.find(fn->realizedName());
+  if (jt == it->second.realizations.end() || !jt->second)
+    return nullptr;
+  return jt->second->ir;
+}
+
+Value *ptrFromFunc(Func *func) {
+  auto *M = func->getModule();
+  auto *funcType = func->getType();
+  auto *rawMethod = M->getOrRealizeMethod(funcType, "__raw__", {funcType});
+  seqassertn(rawMethod, "cannot find function __raw__ method");
+  return util::call(rawMethod, {M->Nr<VarValue>(func)});
+}
+} // namespace
+
+const std::string DevirtualizationPass::KEY = "core-polymorphism-devirtualize";
+
+void DevirtualizationPass::run(Module *module) {
+  slots.clear();
+  unknown.clear();
+  if (auto *cache = module->getCache()) {
+    // mirror the vtable layout from TypecheckVisitor::prepareVTables()
+    for (auto &[_, cls] : cache->classes) {
+      for (auto &[r, real] : cls.realizations) {
+        int64_t offset = 0;
+        for (auto &[base, vtable] : real->vtables) {
+          if (vtable.ir)
+            continue;
+          for (auto &[k, v] : vtable.table) {
+            auto &[fn, id] = v;
+            auto slot = offset + int64_t(id);
+            auto *func = getIRFunc(cache, fn);
+            // the slot might hold a function we know nothing about, so it
+            // cannot be devirtualized
+            if (!func) {
+              unknown.insert(slot);
+              continue;
+            }
+            auto &targets = slots[slot];
+            if (std::none_of(targets.begin(), targets.end(), [func](Func *f) {
+                  return f->getId() == func->getId();
+                }))
+              targets.push_back(func);
+          }
+          offset += vtable.table.size();
+        }
+      }
+    }
+  }
+  OperatorPass::run(module);
+}
+
+void DevirtualizationPass::handle(CallInstr *v) {
+  auto call = analyzeVirtualCall(v);
+  if (!call)
+    return;
+
+  auto it = slots.find(call.id);
+  if (it == slots.end() || unknown.count(call.id))
+    return;
+
+  // slot IDs are shared across hierarchies, so filter by signature as well
+  auto *fnType = cast<types::FuncType>(v->getCallee()->getType());
+  if (!fnType)
+    return;
+  std::vector<Func *> targets;
+  for (auto *func : it->second) {
+    if (func->getType()->is(fnType))
+      targets.push_back(func);
+  }
+  if (targets.empty() || targets.size() > maxTargets)
+    return;
+
+  auto *M = v->getModule();
+  util::CloneVisitor cv(M);
+
+  // monomorphic: just call the target directly
+  if (targets.size() == 1) {
+    std::vector<Value *> args;
+    for (auto *arg : *v) {
+      args.push_back(cv.clone(arg));
+    }
+    v->replaceAll(util::call(targets.front(), args));
+    return;
+  }
+
+  // polymorphic: compare the loaded function pointer against each
+  // target, and fall back to the indirect call if none match
+  auto *parent = cast<BodiedFunc>(getParentFunc());
+  auto *fnNew = util::getFunc(cast<CallInstr>(v->getCallee())->getCallee());
+  if (!parent || !fnNew)
+    return;
+
+  auto *series = M->Nr<SeriesFlow>();
+  auto *fp = util::makeVar(cv.clone(call.slot), series, parent)->getVar();
+  std::vector<Var *> argVars;
+  for (auto *arg : *v) {
+    argVars.push_back(util::makeVar(cv.clone(arg), series, parent)->getVar());
+  }
+  auto getArgs = [&]() {
+    std::vector<Value *> args;
+    for (auto *var : argVars) {
+      args.push_back(M->Nr<VarValue>(var));
+    }
+    return args;
+  };
+
+  auto *retType = fnType->getReturnType();
+  Var *result = nullptr;
+  if (!retType->is(M->getNoneType()) && !retType->is(M->getVoidType())) {
+    result = M->Nr<Var>(retType);
+    parent->push_back(result);
+  }
+  auto branch = [&](Value *val) {
+    return result ? util::series(M->Nr<AssignInstr>(result, val)) : util::series(val);
+  };
+
+  auto *fallbackCallee = util::call(fnNew, {M->Nr<VarValue>(fp)});
+  SeriesFlow *chain = branch(M->Nr<CallInstr>(fallbackCallee, getArgs()));
+
+  for (auto jt = targets.rbegin(); jt != targets.rend(); ++jt) {
+    auto *target = *jt;
+    Value *fast = nullptr;
+    // the target is usually a thunk that just forwards to the derived
+    // method, so inline it to expose the direct call
+    if (auto inlined = util::inlineFunction(target, getArgs(), /*aggressive=*/false,
+                                            v->getSrcInfo())) {
+      for (auto *var : inlined.newVars) {
+        parent->push_back(var);
+      }
+      fast = inlined.result;
+    } else {
+      fast = util::call(target, getArgs());
+    }
+    auto *guard = *M->Nr<VarValue>(fp) == *ptrFromFunc(target);
+    chain = util::series(M->Nr<IfFlow>(guard, branch(fast), chain));
+  }
+
+  series->push_back(chain);
+  if (result) {
+    v->replaceAll(M->Nr<FlowInstr>(series, M->Nr<VarValue>(result)));
+  } else {
+    v->replaceAll(series);
+  }
+}
+
+} // namespace polymorphism
+} // namespace transform
+} // namespace ir
+} // namespace codon
@@ -0,0 +1,48 @@
+// Copyright (C) 2022-2023 Exaloop Inc. <https://exaloop.io>
+
+#pragma once
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "codon/cir/transform/pass.h"
+
+namespace codon {
+namespace ir {
+namespace transform {
+namespace polymorphism {
+
+/// Pass to devirtualize calls made through class vtables. Since all
+/// class realizations are known at this point, the set of functions that
+/// can occupy each vtable slot is known as well. Calls with a single
+/// possible target are replaced with direct calls; calls with a few
+/// possible targets are replaced with guarded direct calls that compare
+/// the loaded function pointer against each candidate, falling back to
+/// the original indirect call otherwise.
+class DevirtualizationPass : public OperatorPass {
+private:
+  /// maximum number of targets for which guarded calls are generated
+  unsigned maxTargets;
+  /// map of vtable slot to functions that can occupy it
+  std::unordered_map<int64_t, std::vector<Func *>> slots;
+  /// vtable slots with an entry that could not be resolved to a function
+  std::unordered_set<int64_t> unknown;
+
+public:
+  static const std::string KEY;
+
+  /// Constructs a devirtualization pass.
+  /// @param maxTargets maximum number of targets for guarded calls
+  explicit DevirtualizationPass(unsigned maxTargets = 4)
+      : OperatorPass(), maxTargets(maxTargets), slots(), unknown() {}
+
+  std::string getKey() const override { return KEY; }
+  void run(Module *module) override;
+  void handle(CallInstr *v) override;
+};
+
+} // namespace polymorphism
+} // namespace transform
+} // namespace ir
+} // namespace codon
@@ -61,6 +61,27 @@ GetCall analyzeGet(CallInstr *call) {
   // call is not correct
   return {};
 }
+
+/// Unwrap series flows that contain a single value.
+/// @param v the value
+/// @return the innermost value
+Value *unwrapSeries(Value *v) {
+  while (auto *series = cast<SeriesFlow>(v)) {
+    if (std::distance(series->begin(), series->end()) != 1)
+      break;
+    v = series->front();
+  }
+  return v;
+}
+
+/// @param flow the flow, may be null
+/// @return true if the flow is null or does nothing
+bool isEmptyFlow(Flow *flow) {
+  if (!flow)
+    return true;
+  auto *series = cast<SeriesFlow>(flow);
+  return series && series->begin() == series->end();
+}
 } // namespace
 
 const std::string DictArithmeticOptimization::KEY = "core-pythonic-dict-arithmetic-opt";
@@ -143,6 +164,56 @@ void DictArithmeticOptimization::handle(CallInstr *v) {
   }
 }
 
+const std::string DictKeyErrorOptimization::KEY = "core-pythonic-dict-key-error-opt";
+
+void DictKeyErrorOptimization::handle(TryCatchFlow *v) {
+  auto *M = v->getModule();
+
+  // must have exactly one catch clause, no finally and no catch variable
+  if (std::distance(v->begin(), v->end()) != 1 || !isEmptyFlow(v->getFinally()))
+    return;
+  auto &c = v->front();
+  if (!c.getType() || c.getVar())
+    return;
+  bool catchesKeyError = false;
+  for (auto *name : {"KeyError", "LookupError"}) {
+    auto *type = M->getOrRealizeType(name, {}, "std.internal.types.error");
+    if (type && c.getType()->is(type))
+      catchesKeyError = true;
+  }
+  if (!catchesKeyError)
+    return;
+
+  // the body must be a single assignment from __getitem__
+  auto *assign = cast<AssignInstr>(unwrapSeries(v->getBody()));
+  if (!assign)
+    return;
+  auto *getCall = cast<CallInstr>(assign->getRhs());
+  if (!getCall)
+    return;
+  auto getAnalysis = analyzeGet(getCall);
+  if (!getAnalysis.func || getAnalysis.dflt)
+    return;
+
+  auto *lhs = assign->getLhs();
+  auto *dictType = getAnalysis.dict->getType();
+  auto *valueType = getCall->getType();
+  if (!lhs->getType()->is(valueType))
+    return;
+  auto *ptrType = M->getPointerType(valueType);
+  auto *tryGetFunc =
+      M->getOrRealizeMethod(dictType, "__dict_try_get__",
+                            {dictType, getAnalysis.key->getType(), ptrType});
+  if (!tryGetFunc || !util::getReturnType(tryGetFunc)->is(M->getBoolType()))
+    return;
+
+  util::CloneVisitor cv(M);
+  auto *found = util::call(tryGetFunc, {cv.clone(getAnalysis.dict),
+                                        cv.clone(getAnalysis.key),
+                                        M->Nr<PointerValue>(lhs)});
+  v->replaceAll(M->Nr<IfFlow>(found, M->Nr<SeriesFlow>(), c.getHandler()));
+}
+
 } // namespace pythonic
 } // namespace transform
 } // namespace ir
@@ -19,6 +19,16 @@ public:
   void handle(CallInstr *v) override;
 };
 
+/// Pass to replace try: x = d[k] except KeyError: ... with a lookup that
+/// does not raise. This will work on any dictionary-like object that
+/// implements __dict_try_get__ as well as __getitem__.
+class DictKeyErrorOptimization : public OperatorPass {
+public:
+  static const std::string KEY;
+  std::string getKey() const override { return KEY; }
+  void handle(TryCatchFlow *v) override;
+};
+
 } // namespace pythonic
 } // namespace transform
 } // namespace ir
@@ -84,7 +84,7 @@ void SimplifyVisitor::visit(WhileStmt *stmt) {
 ///                                      for i in it: ...
 ///                                      if no_break: ...```
 void SimplifyVisitor::visit(ForStmt *stmt) {
-  stmt->decorator = transformForDecorator(stmt->decorator);
+  stmt->decorator = transformForDecorator(stmt->decorator, stmt->suite);
 
   std::string breakVar;
   // Needs in-advance transformation to prevent name clashes with the iterator variable
@@ -135,21 +135,26 @@ void SimplifyVisitor::visit(ForStmt *stmt) {
   ctx->getBase()->loops.pop_back();
 }
 
-/// Transform and check for OpenMP decorator.
+/// Transform and check for OpenMP and vectorization decorators.
+/// Variables listed in the `aligned` clause get an alignment assumption at
+/// the start of the loop body.
 /// @example
 ///   `@par(num_threads=2, openmp="schedule(static)")` ->
 ///   `for_par(num_threads=2, schedule="static")`
-ExprPtr SimplifyVisitor::transformForDecorator(const ExprPtr &decorator) {
+///   `@simd("simdlen(8) aligned(a: 64)")` -> `for_simd(simdlen=8)` (and
+///   `__OMPAssumeAligned(a, 64)` in the loop body)
+ExprPtr SimplifyVisitor::transformForDecorator(const ExprPtr &decorator,
+                                               StmtPtr &suite) {
   if (!decorator)
     return nullptr;
   ExprPtr callee = decorator;
   if (auto c = callee->getCall())
     callee = c->expr;
-  if (!callee || !callee->isId("par"))
+  if (!callee || !(callee->isId("par") || callee->isId("simd")))
     E(Error::LOOP_DECORATOR, decorator);
   std::vector<CallExpr::Arg> args;
   std::string openmp;
-  std::vector<CallExpr::Arg> omp;
+  std::vector<CallExpr::Arg> given, omp;
   if (auto c = decorator->getCall())
     for (auto &a : c->args) {
       if (a.name == "openmp" ||
@@ -157,12 +162,35 @@ ExprPtr SimplifyVisitor::transformForDecorator(const ExprPtr &decorator) {
         omp = parseOpenMP(ctx->cache, a.value->getString()->getValue(),
                           a.value->getSrcInfo());
       } else {
-        args.push_back({a.name, transform(a.value)});
+        given.push_back(a);
       }
     }
-  for (auto &a : omp)
-    args.push_back({a.name, transform(a.value)});
-  return N<CallExpr>(transform(N<IdExpr>("for_par")), args);
+  given.insert(given.end(), omp.begin(), omp.end());
+
+  std::vector<ExprPtr> aligned;
+  ExprPtr alignment = N<IntExpr>(16);
+  for (auto &a : given) {
+    if (a.name == "aligned") {
+      if (auto t = a.value->getTuple())
+        aligned.insert(aligned.end(), t->items.begin(), t->items.end());
+      else
+        aligned.push_back(a.value);
+    } else if (a.name == "alignment") {
+      alignment = a.value;
+    } else {
+      args.push_back({a.name, transform(a.value)});
+    }
+  }
+  if (!aligned.empty()) {
+    std::vector<StmtPtr> stmts;
+    for (auto &var : aligned)
+      stmts.push_back(N<ExprStmt>(
+          N<CallExpr>(N<IdExpr>("__OMPAssumeAligned"), var, clone(alignment))));
+    stmts.push_back(suite);
+    suite = N<SuiteStmt>(stmts);
+  }
+  return N<CallExpr>(
+      transform(N<IdExpr>(callee->isId("par") ? "for_par" : "for_simd")), args);
 }
 
 } // namespace codon::ast
@@ -151,7 +151,7 @@ private: // Node simplification rules
   void visit(BreakStmt *) override;
   void visit(WhileStmt *) override;
   void visit(ForStmt *) override;
-  ExprPtr transformForDecorator(const ExprPtr &);
+  ExprPtr transformForDecorator(const ExprPtr &, StmtPtr &);
 
   /* Errors and exceptions (error.cpp) */
   void visit(AssertStmt *) override;
@@ -433,22 +433,38 @@ void TranslateVisitor::visit(WhileStmt *stmt) {
 
 void TranslateVisitor::visit(ForStmt *stmt) {
   std::unique_ptr<OMPSched> os = nullptr;
+  std::unique_ptr<ir::VectorizeAttribute> vectorize = nullptr;
   if (stmt->decorator) {
-    os = std::make_unique<OMPSched>();
     auto c = stmt->decorator->getCall();
     seqassert(c, "for par is not a call: {}", stmt->decorator);
     auto fc = c->expr->getType()->getFunc();
-    seqassert(fc && fc->ast->name == "std.openmp.for_par:0",
+    seqassert(fc && (fc->ast->name == "std.openmp.for_par:0" ||
+                     fc->ast->name == "std.openmp.for_simd:0"),
               "for par is not a function");
-    auto schedule =
-        fc->funcGenerics[0].type->getStatic()->expr->staticValue.getString();
-    bool ordered = fc->funcGenerics[1].type->getStatic()->expr->staticValue.getInt();
-    auto threads = transform(c->args[0].value);
-    auto chunk = transform(c->args[1].value);
-    int64_t collapse =
-        fc->funcGenerics[2].type->getStatic()->expr->staticValue.getInt();
-    bool gpu = fc->funcGenerics[3].type->getStatic()->expr->staticValue.getInt();
-    os = std::make_unique<OMPSched>(schedule, threads, chunk, ordered, collapse, gpu);
+    auto getInt = [&fc](int i) {
+      return fc->funcGenerics[i].type->getStatic()->expr->staticValue.getInt();
+    };
+
+    if (fc->ast->name == "std.openmp.for_simd:0") {
+      vectorize = std::make_unique<ir::VectorizeAttribute>(getInt(0), getInt(2),
+                                                           getInt(1));
+    } else {
+      auto schedule =
+          fc->funcGenerics[0].type->getStatic()->expr->staticValue.getString();
+      bool ordered = getInt(1);
+      auto threads = transform(c->args[0].value);
+      auto chunk = transform(c->args[1].value);
+      int64_t collapse = getInt(2);
+      bool gpu = getInt(3);
+      bool keepOrder = getInt(4);
+      auto runtime =
+          fc->funcGenerics[5].type->getStatic()->expr->staticValue.getString();
+      os = std::make_unique<OMPSched>(schedule, threads, chunk, ordered, collapse,
+                                      gpu, keepOrder, runtime);
+      if (getInt(6))
+        vectorize = std::make_unique<ir::VectorizeAttribute>(getInt(7), getInt(9),
+                                                             getInt(8));
+    }
   }
 
   seqassert(stmt->var->getId(), "expected IdExpr, got {}", stmt->var);
@@ -465,6 +481,8 @@ void TranslateVisitor::visit(ForStmt *stmt) {
   auto loop = make<ir::ForFlow>(stmt, transform(stmt->iter), bodySeries, var);
   if (os)
     loop->setSchedule(std::move(os));
+  if (vectorize)
+    loop->setAttribute(std::move(vectorize));
   ctx->add(TranslateItem::Var, varName, var);
   ctx->addSeries(cast<ir::SeriesFlow>(loop->getBody()));
   transform(stmt->suite);
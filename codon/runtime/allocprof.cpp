@@ -0,0 +1,335 @@
+// Copyright (C) 2022-2023 Exaloop Inc. <https://exaloop.io>
+
+#include <atomic>
+#include <backtrace.h>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <dlfcn.h>
+#include <fmt/format.h>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "codon/runtime/lib.h"
+
+/*
+ * Allocation profiling
+ *
+ * With SEQ_FLAG_ALLOC_PROFILE, allocations are sampled once every
+ * SAMPLE_INTERVAL bytes on average: each thread counts down a randomly drawn
+ * number of bytes, and the allocation that crosses zero records the stack it
+ * was made from. Since the intervals are exponentially distributed, an
+ * allocation of n bytes is sampled with probability 1 - exp(-n / interval),
+ * and each sample is scaled by the inverse of that to estimate the actual
+ * number of allocations and bytes at its site.
+ *
+ * At exit, samples are symbolized -- with libbacktrace for standalone
+ * binaries, or through the JIT's debug info otherwise -- and written as a
+ * pprof profile to the file named by CODON_ALLOC_PROFILE.
+ */
+
+std::atomic<bool> seq_alloc_profiling(false);
+
+namespace {
+using codon::runtime::SymbolizedFrame;
+
+constexpr double SAMPLE_INTERVAL = 512 * 1024;
+constexpr size_t MAX_FRAMES = 64;
+const char *const DEFAULT_PATH = "codon-alloc.pprof";
+
+struct Totals {
+  double count = 0;
+  double bytes = 0;
+};
+
+struct StackHash {
+  size_t operator()(const std::vector<uintptr_t> &stack) const {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (auto pc : stack) {
+      h ^= pc;
+      h *= 0x100000001b3ULL;
+    }
+    return h;
+  }
+};
+
+std::mutex profileLock;
+std::unordered_map<std::vector<uintptr_t>, Totals, StackHash> samples;
+std::function<bool(uintptr_t, std::vector<SymbolizedFrame> &)> symbolizer;
+bool written = false;
+seq_int_t startNs = 0;
+void *runtimeBase = nullptr; // load address of this library
+std::once_flag profileInit;
+
+struct Sampler {
+  uint64_t rng = 0; // 0 until seeded
+  double untilSample = 0;
+
+  double next() {
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    double u = ((rng >> 11) + 0.5) * 0x1.0p-53; // in (0, 1)
+    return -std::log(u) * SAMPLE_INTERVAL;
+  }
+};
+
+thread_local Sampler sampler;
+
+void ignoreError(void *data, const char *msg, int errnum) {}
+
+int collectFrame(void *data, uintptr_t pc) {
+  auto *stack = static_cast<std::vector<uintptr_t> *>(data);
+  stack->push_back(pc);
+  return stack->size() >= MAX_FRAMES;
+}
+
+bool inRuntime(uintptr_t pc) {
+  Dl_info info;
+  return dladdr(reinterpret_cast<void *>(pc), &info) && info.dli_fbase == runtimeBase;
+}
+
+int pcinfoCallback(void *data, uintptr_t pc, const char *filename, int lineno,
+                   const char *function) {
+  auto *frames = static_cast<std::vector<SymbolizedFrame> *>(data);
+  if (function)
+    frames->push_back({function, filename ? filename : "", lineno});
+  return 0;
+}
+
+void syminfoCallback(void *data, uintptr_t pc, const char *symname, uintptr_t symval,
+                     uintptr_t symsize) {
+  auto *frames = static_cast<std::vector<SymbolizedFrame> *>(data);
+  if (symname)
+    frames->push_back({symname, "", 0});
+}
+
+// Minimal protocol buffer encoder, enough for pprof's profile.proto
+class ProtoWriter {
+  std::string buf;
+
+public:
+  void varint(uint64_t v) {
+    while (v >= 0x80) {
+      buf.push_back(static_cast<char>(v | 0x80));
+      v >>= 7;
+    }
+    buf.push_back(static_cast<char>(v));
+  }
+
+  void number(int field, uint64_t v) {
+    if (!v)
+      return;
+    varint(static_cast<uint64_t>(field) << 3);
+    varint(v);
+  }
+
+  void bytes(int field, const std::string &s) {
+    varint((static_cast<uint64_t>(field) << 3) | 2);
+    varint(s.size());
+    buf += s;
+  }
+
+  void message(int field, const ProtoWriter &m) { bytes(field, m.buf); }
+
+  void packed(int field, const std::vector<uint64_t> &vs) {
+    ProtoWriter p;
+    for (auto v : vs)
+      p.varint(v);
+    bytes(field, p.buf);
+  }
+
+  const std::string &str() const { return buf; }
+};
+
+class ProfileBuilder {
+  ProtoWriter profile;
+  std::unordered_map<std::string, uint64_t> stringIds;
+  std::vector<std::string> strings;
+  std::map<std::pair<std::string, std::string>, uint64_t> functionIds;
+  std::unordered_map<uintptr_t, uint64_t> locationIds;
+
+  uint64_t str(const std::string &s) {
+    auto it = stringIds.find(s);
+    if (it != stringIds.end())
+      return it->second;
+    stringIds.emplace(s, strings.size());
+    strings.push_back(s);
+    return strings.size() - 1;
+  }
+
+  void valueType(int field, const std::string &type, const std::string &unit) {
+    ProtoWriter v;
+    v.number(1, str(type));
+    v.number(2, str(unit));
+    profile.message(field, v);
+  }
+
+  uint64_t function(const SymbolizedFrame &frame) {
+    auto key = std::make_pair(frame.func, frame.file);
+    auto it = functionIds.find(key);
+    if (it != functionIds.end())
+      return it->second;
+    uint64_t id = functionIds.size() + 1;
+    functionIds.emplace(key, id);
+    ProtoWriter f;
+    f.number(1, id);
+    f.number(2, str(frame.func));
+    f.number(3, str(frame.func));
+    f.number(4, str(frame.file));
+    profile.message(5, f);
+    return id;
+  }
+
+public:
+  ProfileBuilder() {
+    str("");
+    valueType(1, "alloc_objects", "count");
+    valueType(1, "alloc_space", "bytes");
+    // one mapping covering everything, already symbolized
+    ProtoWriter m;
+    m.number(1, 1);
+    m.number(3, UINT64_MAX);
+    for (int field = 7; field <= 10; field++)
+      m.number(field, 1);
+    profile.message(3, m);
+  }
+
+  void location(uintptr_t pc, const std::vector<SymbolizedFrame> &frames) {
+    uint64_t id = locationIds.size() + 1;
+    locationIds.emplace(pc, id);
+    ProtoWriter l;
+    l.number(1, id);
+    l.number(2, 1);
+    l.number(3, pc);
+    for (const auto &frame : frames) {
+      ProtoWriter line;
+      line.number(1, function(frame));
+      line.number(2, frame.line > 0 ? frame.line : 0);
+      l.message(4, line);
+    }
+    profile.message(4, l);
+  }
+
+  void sample(const std::vector<uintptr_t> &stack, const Totals &totals) {
+    std::vector<uint64_t> locs;
+    for (auto pc : stack)
+      locs.push_back(locationIds[pc]);
+    ProtoWriter s;
+    s.packed(1, locs);
+    s.packed(2, {static_cast<uint64_t>(std::llround(totals.count)),
+                 static_cast<uint64_t>(std::llround(totals.bytes))});
+    profile.message(2, s);
+  }
+
+  std::string finish(seq_int_t timeNs, seq_int_t durationNs) {
+    valueType(11, "space", "bytes");
+    profile.number(12, static_cast<uint64_t>(SAMPLE_INTERVAL));
+    profile.number(9, timeNs);
+    profile.number(10, durationNs);
+    for (const auto &s : strings)
+      profile.bytes(6, s);
+    return profile.str();
+  }
+};
+} // namespace
+
+void seq_alloc_profile_init() {
+  std::call_once(profileInit, []() {
+    Dl_info info;
+    if (dladdr(reinterpret_cast<void *>(&seq_alloc_profile_init), &info))
+      runtimeBase = info.dli_fbase;
+    startNs = seq_time();
+    seq_alloc_profiling.store(true);
+    atexit(codon::runtime::writeAllocProfile);
+  });
+}
+
+void seq_alloc_profile_sample(size_t n) {
+  if (!sampler.rng) {
+    sampler.rng = (static_cast<uint64_t>(seq_time()) ^
+                   reinterpret_cast<uintptr_t>(&sampler)) |
+                  1;
+    sampler.untilSample = sampler.next();
+  }
+  sampler.untilSample -= static_cast<double>(n);
+  if (sampler.untilSample >= 0)
+    return;
+  sampler.untilSample = sampler.next();
+
+  std::vector<uintptr_t> stack;
+  stack.reserve(MAX_FRAMES);
+  backtrace_simple(/*state=*/nullptr, /*skip=*/0, collectFrame, ignoreError, &stack);
+  // drop frames of the allocator itself
+  size_t skip = 0;
+  while (skip < stack.size() && inRuntime(stack[skip]))
+    skip++;
+  stack.erase(stack.begin(), stack.begin() + skip);
+
+  double p = 1 - std::exp(-static_cast<double>(n) / SAMPLE_INTERVAL);
+  std::lock_guard<std::mutex> guard(profileLock);
+  if (written)
+    return;
+  auto &totals = samples[std::move(stack)];
+  totals.count += 1 / p;
+  totals.bytes += n / p;
+}
+
+void codon::runtime::setAllocProfileSymbolizer(
+    std::function<bool(uintptr_t, std::vector<SymbolizedFrame> &)> callback) {
+  std::lock_guard<std::mutex> guard(profileLock);
+  symbolizer = std::move(callback);
+}
+
+void codon::runtime::writeAllocProfile() {
+  std::lock_guard<std::mutex> guard(profileLock);
+  if (written || !seq_alloc_profiling.load())
+    return;
+  written = true;
+  seq_alloc_profiling.store(false);
+
+  auto symbolize = symbolizer;
+  if (!symbolize) {
+    auto *state = backtrace_create_state(/*filename=*/nullptr, /*threaded=*/0,
+                                         ignoreError, /*data=*/nullptr);
+    symbolize = [state](uintptr_t pc, std::vector<SymbolizedFrame> &frames) {
+      backtrace_pcinfo(state, pc, pcinfoCallback, ignoreError, &frames);
+      if (frames.empty())
+        backtrace_syminfo(state, pc, syminfoCallback, ignoreError, &frames);
+      return !frames.empty();
+    };
+  }
+
+  ProfileBuilder builder;
+  std::unordered_map<uintptr_t, bool> known;
+  for (auto &entry : samples) {
+    auto stack = entry.first;
+    for (auto pc : stack) {
+      if (known.count(pc))
+        continue;
+      std::vector<SymbolizedFrame> frames;
+      known[pc] = symbolize(pc, frames);
+      builder.location(pc, frames);
+    }
+    // drop the frames below the program, e.g. those of the JIT
+    while (!stack.empty() && !known[stack.back()])
+      stack.pop_back();
+    builder.sample(stack, entry.second);
+  }
+
+  const char *path = std::getenv("CODON_ALLOC_PROFILE");
+  if (!path || !*path)
+    path = DEFAULT_PATH;
+  std::ofstream out(path, std::ios::binary);
+  out << builder.finish(startNs, seq_time() - startNs);
+  if (out)
+    fmt::print(stderr, "[alloc-profile] wrote {} stacks to {}\n", samples.size(),
+               path);
+  else
+    fmt::print(stderr, "[alloc-profile] could not write {}\n", path);
+}
@@ -0,0 +1,297 @@
+// Copyright (C) 2022-2023 Exaloop Inc. <https://exaloop.io>
+
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define GC_THREADS
+#include "codon/runtime/lib.h"
+#include <gc.h>
+
+/*
+ * Arena allocation scopes
+ *
+ * While an arena is active on a thread, seq_alloc and friends on that
+ * thread bump-allocate from the arena's chunks instead of calling into the
+ * GC. Chunks are large GC blocks that the arena keeps alive; the ones for
+ * non-atomic data are scanned like any other block, so arena objects can
+ * point to GC objects. Closing the arena frees every chunk at once.
+ *
+ * If an exception is raised while an arena is open, the exception object
+ * may live in (or point into) its chunks, so closing that arena drops its
+ * references to them instead and leaves them to the GC, which reclaims
+ * each one once nothing points into it.
+ *
+ * In debug mode, chunks are mapped pages registered as GC roots, and
+ * closing the arena protects them instead of freeing them, so that a use
+ * of arena memory after its scope faults and is reported as such. Their
+ * pages are handed back to the OS right away; only the address range
+ * stays reserved, and only for the most recent MAX_RETIRED chunks, after
+ * which the oldest range is unmapped.
+ */
+
+namespace {
+constexpr size_t ALIGN = 16;
+constexpr size_t MIN_CHUNK = 1 << 16;
+constexpr size_t MAX_CHUNK = 1 << 26;
+constexpr size_t MAX_RETIRED = 4096; // protected ranges kept to report faults in
+
+struct Chunk {
+  char *base;
+  size_t size;
+  bool atomic;
+};
+
+struct Region {
+  char *cur;
+  char *end;
+};
+
+struct Arena {
+  Arena *outer;  // enclosing open arena on the same thread, if any
+  Chunk *chunks; // reachable through the (uncollectable) arena, as are the chunks
+  size_t nchunks;
+  size_t cap;
+  Region scanned;
+  Region atomic;
+  size_t nextChunk;
+  size_t used;
+  bool open;
+  bool pinned; // an exception was raised while this arena was open
+  bool debug;
+};
+
+thread_local Arena *current = nullptr; // arena that allocations go to
+thread_local Arena *innermost = nullptr; // innermost open arena, active or not
+
+struct Retired {
+  uintptr_t begin;
+  uintptr_t end;
+};
+
+Retired retired[MAX_RETIRED]; // ring buffer of the latest retired chunks
+std::atomic<size_t> numRetired(0);
+std::mutex retiredLock; // for updates; the fault handler only reads
+struct sigaction prevSegv;
+std::atomic<bool> handlerInstalled(false);
+
+void onFault(int sig, siginfo_t *info, void *ctx) {
+  auto addr = reinterpret_cast<uintptr_t>(info->si_addr);
+  size_t n = std::min(numRetired.load(), MAX_RETIRED);
+  for (size_t i = 0; i < n; i++) {
+    if (retired[i].begin <= addr && addr < retired[i].end) {
+      static const char msg[] =
+          "error: arena memory used after its scope ended (an object allocated "
+          "inside 'with arena()' escaped it; allocate it in 'arena.escape()' or "
+          "copy it out with 'arena.keep()')\n";
+      (void)!write(STDERR_FILENO, msg, sizeof(msg) - 1);
+      abort();
+    }
+  }
+  // not ours: re-raise with the previous handler
+  sigaction(SIGSEGV, &prevSegv, nullptr);
+}
+
+void retire(const Chunk &c) {
+  // keep the range inaccessible so that stray uses still fault, but
+  // give its pages back to the OS
+  mprotect(c.base, c.size, PROT_NONE);
+  madvise(c.base, c.size, MADV_DONTNEED);
+
+  Retired evicted = {0, 0};
+  {
+    std::lock_guard<std::mutex> guard(retiredLock);
+    size_t k = numRetired.load();
+    Retired &slot = retired[k % MAX_RETIRED];
+    if (k >= MAX_RETIRED)
+      evicted = slot;
+    slot = {reinterpret_cast<uintptr_t>(c.base),
+            reinterpret_cast<uintptr_t>(c.base + c.size)};
+    numRetired.store(k + 1);
+  }
+
+  // faults in the oldest range can no longer be reported, so unmap it
+  if (evicted.end)
+    munmap(reinterpret_cast<void *>(evicted.begin), evicted.end - evicted.begin);
+}
+
+void installFaultHandler() {
+  if (handlerInstalled.exchange(true))
+    return;
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_sigaction = onFault;
+  action.sa_flags = SA_SIGINFO;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGSEGV, &action, &prevSegv);
+}
+
+size_t roundUp(size_t n, size_t to) { return (n + to - 1) & ~(to - 1); }
+
+char *newChunk(Arena *arena, size_t size, bool atomic) {
+  char *base;
+  if (arena->debug) {
+    size = roundUp(size, static_cast<size_t>(sysconf(_SC_PAGESIZE)));
+    void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                   -1, 0);
+    if (p == MAP_FAILED)
+      return nullptr;
+    base = static_cast<char *>(p);
+    if (!atomic)
+      GC_add_roots(base, base + size);
+  } else {
+    base = static_cast<char *>(atomic ? GC_MALLOC_ATOMIC(size) : GC_MALLOC(size));
+    if (!base)
+      return nullptr;
+  }
+
+  if (arena->nchunks == arena->cap) {
+    arena->cap = arena->cap ? 2 * arena->cap : 8;
+    arena->chunks = static_cast<Chunk *>(
+        GC_REALLOC(arena->chunks, arena->cap * sizeof(Chunk)));
+  }
+  arena->chunks[arena->nchunks++] = {base, size, atomic};
+  return base;
+}
+
+void *allocSlow(Arena *arena, size_t n, bool atomic) {
+  Region &region = atomic ? arena->atomic : arena->scanned;
+  if (n > arena->nextChunk / 4) {
+    // big objects get a chunk of their own; keep bumping in the current one
+    return newChunk(arena, n, atomic);
+  }
+  size_t size = arena->nextChunk;
+  arena->nextChunk = std::min(2 * arena->nextChunk, MAX_CHUNK);
+  char *base = newChunk(arena, size, atomic);
+  if (!base)
+    return nullptr;
+  region.cur = base + n;
+  region.end = base + size;
+  return base;
+}
+
+void *alloc(Arena *arena, size_t n, bool atomic) {
+  n = roundUp(n ? n : 1, ALIGN);
+  arena->used += n;
+  Region &region = atomic ? arena->atomic : arena->scanned;
+  if (static_cast<size_t>(region.end - region.cur) >= n) {
+    char *p = region.cur;
+    region.cur += n;
+    return p;
+  }
+  return allocSlow(arena, n, atomic);
+}
+
+const Chunk *findChunk(void *p) {
+  auto *q = static_cast<char *>(p);
+  for (Arena *arena = innermost; arena; arena = arena->outer) {
+    // newest first, since reallocs and frees mostly hit recent objects
+    for (size_t i = arena->nchunks; i-- > 0;) {
+      const Chunk &c = arena->chunks[i];
+      if (c.base <= q && q < c.base + c.size)
+        return &c;
+    }
+  }
+  return nullptr;
+}
+
+void release(Arena *arena) {
+  for (size_t i = 0; i < arena->nchunks; i++) {
+    Chunk &c = arena->chunks[i];
+    if (arena->debug) {
+      if (arena->pinned)
+        continue; // leaked on purpose: only debug builds get here
+      if (!c.atomic)
+        GC_remove_roots(c.base, c.base + c.size);
+      retire(c);
+    } else if (!arena->pinned) {
+      GC_FREE(c.base);
+    }
+  }
+  GC_FREE(arena->chunks);
+  arena->chunks = nullptr;
+  arena->nchunks = arena->cap = 0;
+}
+} // namespace
+
+void *seq_arena_alloc(size_t n, bool atomic) {
+  Arena *arena = current;
+  return arena ? alloc(arena, n, atomic) : nullptr;
+}
+
+bool seq_arena_owns(void *p) { return innermost && findChunk(p); }
+
+void *seq_arena_realloc(void *p, size_t newsize, size_t oldsize) {
+  if (!innermost)
+    return nullptr;
+  const Chunk *chunk = findChunk(p);
+  if (!chunk)
+    return nullptr;
+  bool atomic = chunk->atomic;
+
+  // the last object in the active region can grow in place
+  if (Arena *arena = current) {
+    Region &region = atomic ? arena->atomic : arena->scanned;
+    char *q = static_cast<char *>(p);
+    size_t oldRounded = roundUp(oldsize ? oldsize : 1, ALIGN);
+    size_t newRounded = roundUp(newsize ? newsize : 1, ALIGN);
+    if (q + oldRounded == region.cur && q + newRounded <= region.end) {
+      arena->used += newRounded - std::min(oldRounded, newRounded);
+      region.cur = q + newRounded;
+      return p;
+    }
+  }
+
+  void *r = seq_arena_alloc(newsize, atomic);
+  if (!r)
+    r = atomic ? GC_MALLOC_ATOMIC(newsize) : GC_MALLOC(newsize);
+  memcpy(r, p, std::min(oldsize, newsize));
+  return r;
+}
+
+void seq_arena_pin() {
+  for (Arena *arena = innermost; arena; arena = arena->outer)
+    arena->pinned = true;
+}
+
+SEQ_FUNC void *seq_arena_new() {
+  auto *arena = static_cast<Arena *>(GC_MALLOC_UNCOLLECTABLE(sizeof(Arena)));
+  memset(arena, 0, sizeof(Arena));
+  arena->nextChunk = MIN_CHUNK;
+  arena->debug = (seq_flags & SEQ_FLAG_DEBUG) != 0;
+  if (arena->debug)
+    installFaultHandler();
+  return arena;
+}
+
+SEQ_FUNC void *seq_arena_set(void *arena) {
+  Arena *prev = current;
+  auto *a = static_cast<Arena *>(arena);
+  if (a && !a->open) {
+    a->open = true;
+    a->outer = innermost;
+    innermost = a;
+  }
+  current = a;
+  return prev;
+}
+
+SEQ_FUNC void seq_arena_free(void *arena) {
+  auto *a = static_cast<Arena *>(arena);
+  if (current == a)
+    current = nullptr;
+  if (innermost == a)
+    innermost = a->outer;
+  release(a);
+  GC_FREE(a);
+}
+
+SEQ_FUNC seq_int_t seq_arena_used(void *arena) {
+  return static_cast<seq_int_t>(static_cast<Arena *>(arena)->used);
+}
@@ -14,65 +14,20 @@
 #include <string>
 #include <vector>
 
-struct BacktraceFrame {
-  char *function;
-  char *filename;
-  uintptr_t pc;
-  int32_t lineno;
-};
-
+// Raw return addresses; symbolized only if the exception is printed
 struct Backtrace {
   static const size_t LIMIT = 20;
-  struct BacktraceFrame *frames;
+  uintptr_t pcs[LIMIT];
   size_t count;
-
-  void push_back(const char *function, const char *filename, uintptr_t pc,
-                 int32_t lineno) {
-    if (count >= LIMIT || !function || !filename) {
-      return;
-    } else if (count == 0) {
-      frames = (BacktraceFrame *)seq_alloc(LIMIT * sizeof(*frames));
-    }
-
-    size_t functionLen = strlen(function) + 1;
-    auto *functionDup = (char *)seq_alloc_atomic(functionLen);
-    memcpy(functionDup, function, functionLen);
-
-    size_t filenameLen = strlen(filename) + 1;
-    auto *filenameDup = (char *)seq_alloc_atomic(filenameLen);
-    memcpy(filenameDup, filename, filenameLen);
-
-    frames[count++] = {functionDup, filenameDup, pc, lineno};
-  }
-
-  void push_back(uintptr_t pc) { push_back("<invalid>", "<invalid>", pc, 0); }
-
-  void free() {
-    for (auto i = 0; i < count; i++) {
-      auto *frame = &frames[i];
-      seq_free(frame->function);
-      seq_free(frame->filename);
-    }
-    seq_free(frames);
-    frames = nullptr;
-    count = 0;
-  }
 };
 
 void seq_backtrace_error_callback(void *data, const char *msg, int errnum) {
   // printf("seq_backtrace_error_callback: %s (errnum = %d)\n", msg, errnum);
 }
 
-int seq_backtrace_full_callback(void *data, uintptr_t pc, const char *filename,
-                                int lineno, const char *function) {
-  auto *bt = ((Backtrace *)data);
-  bt->push_back(function, filename, pc, lineno);
-  return (bt->count < Backtrace::LIMIT) ? 0 : 1;
-}
-
 int seq_backtrace_simple_callback(void *data, uintptr_t pc) {
   auto *bt = ((Backtrace *)data);
-  bt->push_back(pc);
+  bt->pcs[bt->count++] = pc;
   return (bt->count < Backtrace::LIMIT) ? 0 : 1;
 }
 
@@ -131,19 +86,64 @@ struct SeqExcHeader_t {
   void *python_type;
 };
 
+// arena.cpp
+void seq_arena_pin();
+
 void seq_exc_init() {
   ourBaseFromUnwindOffset = seq_exc_offset();
   ourBaseExceptionClass = seq_exc_class();
 }
 
+// Exceptions used for control flow (e.g. StopIteration or a KeyError that is
+// caught right away) are frequent, so each thread keeps a few exception
+// objects that have been caught for reuse by the next raise.
+namespace {
+struct ExcPool {
+  static const size_t CAPACITY = 8;
+  OurException **slots = nullptr; // uncollectable, so the GC sees pooled objects
+  size_t count = 0;
+  // object and type of the exception caught last, for seq_exc_capture()
+  void **caught = nullptr; // uncollectable as well
+  int caughtType = 0;
+
+  OurException *pop() { return count ? slots[--count] : nullptr; }
+
+  void push(OurException *e) {
+    if (!slots)
+      slots = (OurException **)seq_alloc_uncollectable(CAPACITY * sizeof(*slots));
+    for (size_t i = 0; i < count; i++) {
+      if (slots[i] == e)
+        return;
+    }
+    if (count < CAPACITY) {
+      e->obj = nullptr;
+      slots[count++] = e;
+    }
+  }
+
+  void setCaught(OurException *e) {
+    if (!caught)
+      caught = (void **)seq_alloc_uncollectable(sizeof(*caught));
+    caughtType = e->type.type;
+    *caught = e->obj;
+  }
+
+  ~ExcPool() {
+    if (slots)
+      seq_free(slots); // pooled objects become garbage
+    if (caught)
+      seq_free(caught);
+  }
+};
+
+thread_local ExcPool excPool;
+} // namespace
+
 static void seq_delete_exc(_Unwind_Exception *expToDelete) {
   if (!expToDelete || expToDelete->exception_class != ourBaseExceptionClass)
     return;
   auto *exc = (OurException *)((char *)expToDelete + ourBaseFromUnwindOffset);
-  if (seq_flags & SEQ_FLAG_DEBUG) {
-    exc->bt.free();
-  }
-  seq_free(exc);
+  excPool.push(exc);
 }
 
 static void seq_delete_unwind_exc(_Unwind_Reason_Code reason,
@@ -155,36 +155,98 @@ static struct backtrace_state *state = nullptr;
 static std::mutex stateLock;
 
 SEQ_FUNC void *seq_alloc_exc(int type, void *obj) {
+  // the exception may outlive any arena scope it was raised in
+  seq_arena_pin();
   const size_t size = sizeof(OurException);
-  auto *e = (OurException *)memset(seq_alloc(size), 0, size);
+  auto *e = excPool.pop();
+  if (e) {
+    memset(&e->unwindException, 0, sizeof(e->unwindException));
+    e->bt.count = 0;
+  } else {
+    e = (OurException *)memset(seq_alloc(size), 0, size);
+  }
   assert(e);
   e->type.type = type;
   e->obj = obj;
   e->unwindException.exception_class = ourBaseExceptionClass;
   e->unwindException.exception_cleanup = seq_delete_unwind_exc;
   if (seq_flags & SEQ_FLAG_DEBUG) {
-    e->bt.frames = nullptr;
-    e->bt.count = 0;
-
-    if (seq_flags & SEQ_FLAG_STANDALONE) {
-      if (!state) {
-        stateLock.lock();
-        if (!state)
-          state =
-              backtrace_create_state(/*filename=*/nullptr, /*threaded=*/1,
-                                     seq_backtrace_error_callback, /*data=*/nullptr);
-        stateLock.unlock();
-      }
-      backtrace_full(state, /*skip=*/1, seq_backtrace_full_callback,
+    backtrace_simple(/*state=*/nullptr, /*skip=*/1, seq_backtrace_simple_callback,
                      seq_backtrace_error_callback, &e->bt);
-    } else {
-      backtrace_simple(/*state=*/nullptr, /*skip=*/1, seq_backtrace_simple_callback,
-                       seq_backtrace_error_callback, &e->bt);
-    }
   }
   return &(e->unwindException);
 }
 
+SEQ_FUNC void seq_free_exc(void *exc) {
+  auto *unwind = (_Unwind_Exception *)exc;
+  if (unwind && unwind->exception_class == ourBaseExceptionClass)
+    excPool.setCaught((OurException *)((char *)unwind + ourBaseFromUnwindOffset));
+  seq_delete_exc(unwind);
+}
+
+// Exceptions are caught by their exact type, so a handler that should pass on
+// whatever it caught (e.g. to another thread) cannot name it. Instead, it can
+// call seq_exc_capture() first thing to get a copy of the exception, which
+// seq_exc_rethrow() raises again -- with its original type -- as often as
+// needed.
+SEQ_FUNC void *seq_exc_capture() {
+  void *obj = excPool.caught ? *excPool.caught : nullptr;
+  if (!obj)
+    return nullptr;
+  int type = excPool.caughtType;
+  *excPool.caught = nullptr;
+  // not from the pool, since the copy is kept
+  const size_t size = sizeof(OurException);
+  auto *e = (OurException *)memset(seq_alloc(size), 0, size);
+  e->type.type = type;
+  e->obj = obj;
+  return &(e->unwindException);
+}
+
+SEQ_FUNC void *seq_exc_obj(void *exc) {
+  return ((OurException *)((char *)exc + ourBaseFromUnwindOffset))->obj;
+}
+
+SEQ_FUNC void seq_exc_rethrow(void *exc) {
+  auto *captured = (OurException *)((char *)exc + ourBaseFromUnwindOffset);
+  seq_throw(seq_alloc_exc(captured->type.type, captured->obj));
+}
+
+namespace {
+struct PrintedFrames {
+  std::ostringstream *buf;
+  size_t count;
+};
+
+int printFrameCallback(void *data, uintptr_t pc, const char *filename, int lineno,
+                       const char *function) {
+  auto *printed = (PrintedFrames *)data;
+  if (!function || !filename || printed->count >= Backtrace::LIMIT)
+    return 0;
+  if (printed->count++ == 0)
+    *printed->buf << "\n\033[1mBacktrace:\033[0m\n";
+  *printed->buf << "  "
+                << codon::runtime::makeBacktraceFrameString(pc, std::string(function),
+                                                            std::string(filename),
+                                                            lineno)
+                << "\n";
+  return 0;
+}
+
+void printBacktrace(const Backtrace &bt, std::ostringstream &buf) {
+  if (!state) {
+    std::lock_guard<std::mutex> guard(stateLock);
+    if (!state)
+      state = backtrace_create_state(/*filename=*/nullptr, /*threaded=*/1,
+                                     seq_backtrace_error_callback, /*data=*/nullptr);
+  }
+  PrintedFrames printed = {&buf, 0};
+  for (size_t i = 0; i < bt.count; i++)
+    backtrace_pcinfo(state, bt.pcs[i], printFrameCallback,
+                     seq_backtrace_error_callback, &printed);
+}
+} // namespace
+
 static void print_from_last_dot(seq_str_t s, std::ostringstream &buf) {
   char *p = s.str;
   int64_t n = s.len;
@@ -236,20 +298,8 @@ SEQ_FUNC void seq_terminate(void *exc) {
   }
   buf << "\n";
 
-  if ((seq_flags & SEQ_FLAG_DEBUG) && (seq_flags & SEQ_FLAG_STANDALONE)) {
-    auto *bt = &base->bt;
-    if (bt->count > 0) {
-      buf << "\n\033[1mBacktrace:\033[0m\n";
-      for (unsigned i = 0; i < bt->count; i++) {
-        auto *frame = &bt->frames[i];
-        buf << "  "
-            << codon::runtime::makeBacktraceFrameString(
-                   frame->pc, std::string(frame->function),
-                   std::string(frame->filename), frame->lineno)
-            << "\n";
-      }
-    }
-  }
+  if ((seq_flags & SEQ_FLAG_DEBUG) && (seq_flags & SEQ_FLAG_STANDALONE))
+    printBacktrace(base->bt, buf);
 
   auto output = buf.str();
   if (seq_flags & SEQ_FLAG_STANDALONE) {
@@ -263,9 +313,7 @@ SEQ_FUNC void seq_terminate(void *exc) {
 
     std::vector<uintptr_t> backtrace;
     if (seq_flags & SEQ_FLAG_DEBUG) {
-      for (unsigned i = 0; i < bt->count; i++) {
-        backtrace.push_back(bt->frames[i].pc);
-      }
+      backtrace.assign(bt->pcs, bt->pcs + bt->count);
     }
     codon::runtime::JITError e(output, msg, type, file, (int)hdr->line, (int)hdr->col,
                                backtrace);
@@ -1,9 +1,12 @@
 // Copyright (C) 2022-2023 Exaloop Inc. <https://exaloop.io>
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cerrno>
 #include <chrono>
 #include <climits>
+#include <condition_variable>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
@@ -21,9 +24,16 @@
 #include <unwind.h>
 #include <vector>
 
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
 #define GC_THREADS
 #include "codon/runtime/lib.h"
 #include <gc.h>
+#include <gc_mark.h>
+#include <gc_typed.h>
 
 /*
  * General
@@ -38,6 +48,17 @@ extern "C" void __kmpc_set_gc_callbacks(gc_setup_callback get_stack_base,
                                         gc_roots_callback del_roots);
 
 void seq_exc_init();
+void seq_gc_stats_init();
+
+// arena.cpp
+void *seq_arena_alloc(size_t n, bool atomic);
+void *seq_arena_realloc(void *p, size_t newsize, size_t oldsize);
+bool seq_arena_owns(void *p);
+
+// allocprof.cpp
+extern std::atomic<bool> seq_alloc_profiling;
+void seq_alloc_profile_init();
+void seq_alloc_profile_sample(size_t n);
 
 #ifdef CODON_GPU
 void seq_nvptx_init();
@@ -56,6 +77,9 @@ SEQ_FUNC void seq_init(int flags) {
   seq_nvptx_init();
 #endif
   seq_flags = flags;
+  seq_gc_stats_init();
+  if (flags & SEQ_FLAG_ALLOC_PROFILE)
+    seq_alloc_profile_init();
 }
 
 SEQ_FUNC bool seq_is_macos() {
@@ -149,10 +173,82 @@ SEQ_FUNC char **seq_env() { return environ; }
  */
 #define USE_STANDARD_MALLOC 0
 
+#if !USE_STANDARD_MALLOC
+namespace {
+// GC statistics; see seq_gc_stats_enable()
+std::atomic<bool> statsEnabled(false);
+thread_local seq_int_t threadBytes = 0;
+
+inline void countAlloc(size_t n) {
+  if (statsEnabled.load(std::memory_order_relaxed))
+    threadBytes += static_cast<seq_int_t>(n);
+  if (seq_alloc_profiling.load(std::memory_order_relaxed))
+    seq_alloc_profile_sample(n);
+}
+
+// The GC's own thread-local free lists cover objects of up to 24 granules;
+// larger ones would take the allocator lock on every allocation. For those,
+// up to the largest size that GC_malloc_many batches (half a heap block),
+// each thread keeps lists of objects obtained a batch at a time.
+constexpr size_t GRANULE_BYTES = 16;
+constexpr size_t MIN_BATCH_GRANULES = 25;
+constexpr size_t MAX_BATCH_GRANULES = 128;
+
+struct BatchLists {
+  void *lists[MAX_BATCH_GRANULES + 1];
+};
+
+// Allocated uncollectable, so that the GC sees the objects on the lists.
+struct BatchListsHolder {
+  BatchLists *batches = nullptr;
+
+  BatchLists *get() {
+    if (!batches) {
+      batches = static_cast<BatchLists *>(GC_MALLOC_UNCOLLECTABLE(sizeof(BatchLists)));
+      if (batches)
+        memset(batches, 0, sizeof(BatchLists));
+    }
+    return batches;
+  }
+
+  ~BatchListsHolder() {
+    if (batches)
+      GC_FREE(batches); // unused objects become garbage
+  }
+};
+
+thread_local BatchListsHolder batchLists;
+
+void *allocBatched(size_t n) {
+  size_t granules = (n + GRANULE_BYTES - 1) / GRANULE_BYTES;
+  if (granules < MIN_BATCH_GRANULES || granules > MAX_BATCH_GRANULES)
+    return nullptr;
+  BatchLists *batches = batchLists.get();
+  if (!batches)
+    return nullptr;
+  void *&list = batches->lists[granules];
+  if (!list) {
+    list = GC_malloc_many(granules * GRANULE_BYTES);
+    if (!list)
+      return nullptr;
+  }
+  void *p = list;
+  list = GC_NEXT(p);
+  GC_NEXT(p) = nullptr;
+  return p;
+}
+} // namespace
+#endif
+
 SEQ_FUNC void *seq_alloc(size_t n) {
 #if USE_STANDARD_MALLOC
   return malloc(n);
 #else
+  countAlloc(n);
+  if (void *p = seq_arena_alloc(n, /*atomic=*/false))
+    return p;
+  if (void *p = allocBatched(n))
+    return p;
   return GC_MALLOC(n);
 #endif
 }
@@ -161,6 +257,9 @@ SEQ_FUNC void *seq_alloc_atomic(size_t n) {
 #if USE_STANDARD_MALLOC
   return malloc(n);
 #else
+  countAlloc(n);
+  if (void *p = seq_arena_alloc(n, /*atomic=*/true))
+    return p;
   return GC_MALLOC_ATOMIC(n);
 #endif
 }
@@ -169,6 +268,7 @@ SEQ_FUNC void *seq_alloc_uncollectable(size_t n) {
 #if USE_STANDARD_MALLOC
   return malloc(n);
 #else
+  countAlloc(n);
   return GC_MALLOC_UNCOLLECTABLE(n);
 #endif
 }
@@ -177,6 +277,7 @@ SEQ_FUNC void *seq_alloc_atomic_uncollectable(size_t n) {
 #if USE_STANDARD_MALLOC
   return malloc(n);
 #else
+  countAlloc(n);
   return GC_MALLOC_ATOMIC_UNCOLLECTABLE(n);
 #endif
 }
@@ -186,7 +287,7 @@ SEQ_FUNC void *seq_calloc(size_t m, size_t n) {
   return calloc(m, n);
 #else
   size_t s = m * n;
-  void *p = GC_MALLOC(s);
+  void *p = seq_alloc(s);
   memset(p, 0, s);
   return p;
 #endif
@@ -197,31 +298,222 @@ SEQ_FUNC void *seq_calloc_atomic(size_t m, size_t n) {
   return calloc(m, n);
 #else
   size_t s = m * n;
-  void *p = GC_MALLOC_ATOMIC(s);
+  void *p = seq_alloc_atomic(s);
   memset(p, 0, s);
   return p;
 #endif
 }
 
+#if !USE_STANDARD_MALLOC
+namespace {
+// Smaller objects are cheap to scan conservatively, and typed allocation
+// bypasses the GC's thread-local free lists, so it only pays off above this.
+constexpr size_t TYPED_ALLOC_MIN = 256;
+
+// GC kinds of explicitly typed objects and arrays, once we have seen one
+std::atomic<int> typedKind(-1);
+std::atomic<int> typedArrayKind(-1);
+
+GC_descr layoutDescriptor(seq_gc_layout_t *layout) {
+  auto d = __atomic_load_n(&layout->descr, __ATOMIC_ACQUIRE);
+  if (!d) {
+    // racing threads compute the same descriptor
+    d = GC_make_descriptor(const_cast<GC_word *>(
+                               reinterpret_cast<const GC_word *>(layout->bitmap)),
+                           layout->nwords);
+    __atomic_store_n(&layout->descr, d, __ATOMIC_RELEASE);
+  }
+  return d;
+}
+
+void noteKind(std::atomic<int> &kind, void *p) {
+  if (p && kind.load(std::memory_order_relaxed) < 0)
+    kind.store(GC_get_kind_and_size(p, nullptr), std::memory_order_relaxed);
+}
+
+bool isTyped(void *p) {
+  int k1 = typedKind.load(std::memory_order_relaxed);
+  int k2 = typedArrayKind.load(std::memory_order_relaxed);
+  if (k1 < 0 && k2 < 0)
+    return false;
+  int k = GC_get_kind_and_size(p, nullptr);
+  return k == k1 || k == k2;
+}
+} // namespace
+#endif
+
 SEQ_FUNC void *seq_realloc(void *p, size_t newsize, size_t oldsize) {
 #if USE_STANDARD_MALLOC
   return realloc(p, newsize);
 #else
+  if (seq_alloc_profiling.load(std::memory_order_relaxed))
+    seq_alloc_profile_sample(newsize);
+  if (void *q = seq_arena_realloc(p, newsize, oldsize))
+    return q;
+  if (p && isTyped(p)) {
+    // GC_REALLOC would drop the type descriptor; fall back to a conservative copy
+    void *q = GC_MALLOC(newsize);
+    memcpy(q, p, std::min(oldsize, newsize));
+    GC_FREE(p);
+    return q;
+  }
   return GC_REALLOC(p, newsize);
 #endif
 }
 
+SEQ_FUNC void *seq_alloc_typed(size_t n, seq_gc_layout_t *layout) {
+#if USE_STANDARD_MALLOC
+  return malloc(n);
+#else
+  countAlloc(n);
+  // for comparison with conservative scanning
+  static const bool disabled = std::getenv("CODON_GC_CONSERVATIVE") != nullptr;
+  if (void *p = seq_arena_alloc(n, /*atomic=*/false))
+    return p;
+  size_t size = layout->size;
+  if (disabled || n < TYPED_ALLOC_MIN || n < size || n % size != 0)
+    return GC_MALLOC(n);
+  void *p;
+  if (n == size) {
+    p = GC_MALLOC_EXPLICITLY_TYPED(n, layoutDescriptor(layout));
+    noteKind(typedKind, p);
+  } else {
+    p = GC_CALLOC_EXPLICITLY_TYPED(n / size, size, layoutDescriptor(layout));
+    noteKind(typedArrayKind, p);
+  }
+  return p;
+#endif
+}
+
+SEQ_FUNC void *seq_realloc_typed(void *p, size_t newsize, size_t oldsize,
+                                 seq_gc_layout_t *layout) {
+#if USE_STANDARD_MALLOC
+  return realloc(p, newsize);
+#else
+  if (void *q = seq_arena_realloc(p, newsize, oldsize))
+    return q;
+  void *q = seq_alloc_typed(newsize, layout);
+  if (p) {
+    memcpy(q, p, std::min(oldsize, newsize));
+    GC_FREE(p);
+  }
+  return q;
+#endif
+}
+
 SEQ_FUNC void seq_free(void *p) {
 #if USE_STANDARD_MALLOC
   free(p);
 #else
-  GC_FREE(p);
+  if (!seq_arena_owns(p)) // arena memory goes away with its arena
+    GC_FREE(p);
 #endif
 }
 
 SEQ_FUNC void seq_register_finalizer(void *p, void (*f)(void *obj, void *data)) {
 #if !USE_STANDARD_MALLOC
-  GC_REGISTER_FINALIZER(p, f, nullptr, nullptr, nullptr);
+  if (!seq_arena_owns(p)) // arena objects are never finalized
+    GC_REGISTER_FINALIZER(p, f, nullptr, nullptr, nullptr);
+#endif
+}
+
+SEQ_FUNC void seq_gc_collect() {
+#if !USE_STANDARD_MALLOC
+  GC_gcollect();
+#endif
+}
+
+#if !USE_STANDARD_MALLOC
+namespace {
+std::atomic<seq_int_t> pauses(0);
+std::atomic<seq_int_t> pauseTotalNs(0);
+std::atomic<seq_int_t> pauseMaxNs(0);
+std::atomic<seq_int_t> pauseHist[SEQ_GC_PAUSE_BUCKETS];
+std::chrono::steady_clock::time_point pauseStart;
+std::once_flag statsInit;
+
+// runs with the allocator lock held, so collections don't overlap
+void onCollectionEvent(GC_EventType event) {
+  if (event == GC_EVENT_START) {
+    pauseStart = std::chrono::steady_clock::now();
+  } else if (event == GC_EVENT_END) {
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  std::chrono::steady_clock::now() - pauseStart)
+                  .count();
+    pauses.fetch_add(1, std::memory_order_relaxed);
+    pauseTotalNs.fetch_add(ns, std::memory_order_relaxed);
+    if (ns > pauseMaxNs.load(std::memory_order_relaxed))
+      pauseMaxNs.store(ns, std::memory_order_relaxed);
+    int bucket = 0;
+    for (auto us = ns / 1000; us > 1 && bucket < SEQ_GC_PAUSE_BUCKETS - 1; us >>= 1)
+      bucket++;
+    pauseHist[bucket].fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+std::string formatBytes(double n) {
+  const char *units[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+  int u = 0;
+  while (n >= 1024 && u < 4) {
+    n /= 1024;
+    u++;
+  }
+  return fmt::format("{:.1f} {}", n, units[u]);
+}
+
+void printStatsSummary() {
+  seq_gc_stats_t stats;
+  seq_gc_stats(&stats);
+  fmt::print(stderr,
+             "[gc] {} collections, {:.3f} ms paused (longest {:.3f} ms); heap {}, "
+             "{} allocated, {} by the main thread\n",
+             stats.collections, stats.pause_total_ns / 1e6, stats.pause_max_ns / 1e6,
+             formatBytes(stats.heap_size), formatBytes(stats.total_bytes),
+             formatBytes(stats.thread_bytes));
+  for (int i = 0; i < SEQ_GC_PAUSE_BUCKETS; i++) {
+    if (stats.pause_hist[i])
+      fmt::print(stderr, "[gc]   {:>9} us: {}\n",
+                 i ? fmt::format(">= {}", 1 << i) : "< 2", stats.pause_hist[i]);
+  }
+}
+} // namespace
+#endif
+
+SEQ_FUNC void seq_gc_stats_enable() {
+#if !USE_STANDARD_MALLOC
+  std::call_once(statsInit, []() {
+    GC_set_on_collection_event(onCollectionEvent);
+    statsEnabled.store(true);
+  });
+#endif
+}
+
+SEQ_FUNC void seq_gc_stats(seq_gc_stats_t *stats) {
+  memset(stats, 0, sizeof(*stats));
+#if !USE_STANDARD_MALLOC
+  stats->heap_size = static_cast<seq_int_t>(GC_get_heap_size());
+  stats->free_bytes = static_cast<seq_int_t>(GC_get_free_bytes());
+  stats->unmapped_bytes = static_cast<seq_int_t>(GC_get_unmapped_bytes());
+  stats->bytes_since_gc = static_cast<seq_int_t>(GC_get_bytes_since_gc());
+  stats->total_bytes = static_cast<seq_int_t>(GC_get_total_bytes());
+  stats->collections = static_cast<seq_int_t>(GC_get_gc_no());
+  stats->pauses = pauses.load(std::memory_order_relaxed);
+  stats->pause_total_ns = pauseTotalNs.load(std::memory_order_relaxed);
+  stats->pause_max_ns = pauseMaxNs.load(std::memory_order_relaxed);
+  stats->thread_bytes = threadBytes;
+  for (int i = 0; i < SEQ_GC_PAUSE_BUCKETS; i++)
+    stats->pause_hist[i] = pauseHist[i].load(std::memory_order_relaxed);
+#endif
+}
+
+// prints a summary at exit if CODON_GC_STATS is set
+void seq_gc_stats_init() {
+#if !USE_STANDARD_MALLOC
+  static std::once_flag summary;
+  if (std::getenv("CODON_GC_STATS")) {
+    seq_gc_stats_enable();
+    std::call_once(summary, []() { std::atexit(printStatsSummary); });
+  }
 #endif
 }
 
@@ -395,3 +687,57 @@ SEQ_FUNC void seq_rlock_release(void *lock) {
   auto *m = (std::recursive_timed_mutex *)lock;
   m->unlock();
 }
+
+// Waiting on and waking up an address, as with a Linux futex; used by the
+// lock in the threading module. Elsewhere, waiters park on one of a fixed
+// set of condition variables chosen by address.
+#ifndef __linux__
+namespace {
+struct ParkingBucket {
+  std::mutex mutex;
+  std::condition_variable cond;
+};
+
+ParkingBucket &parkingBucket(int32_t *addr) {
+  static ParkingBucket buckets[64];
+  return buckets[(reinterpret_cast<uintptr_t>(addr) >> 2) % 64];
+}
+} // namespace
+#endif
+
+SEQ_FUNC bool seq_futex_wait(int32_t *addr, int32_t val, double timeout) {
+#ifdef __linux__
+  struct timespec ts;
+  struct timespec *tsp = nullptr;
+  if (timeout >= 0.0) {
+    ts.tv_sec = (time_t)timeout;
+    ts.tv_nsec = (long)((timeout - (double)ts.tv_sec) * 1e9);
+    tsp = &ts;
+  }
+  long r = syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, tsp, nullptr, 0);
+  return !(r == -1 && errno == ETIMEDOUT);
+#else
+  auto &bucket = parkingBucket(addr);
+  std::unique_lock<std::mutex> lock(bucket.mutex);
+  if (__atomic_load_n(addr, __ATOMIC_RELAXED) != val)
+    return true;
+  if (timeout < 0.0) {
+    bucket.cond.wait(lock);
+    return true;
+  }
+  return bucket.cond.wait_for(lock, std::chrono::duration<double>(timeout)) ==
+         std::cv_status::no_timeout;
+#endif
+}
+
+SEQ_FUNC void seq_futex_wake(int32_t *addr, seq_int_t n) {
+#ifdef __linux__
+  syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, (int)std::min<seq_int_t>(n, INT_MAX),
+          nullptr, nullptr, 0);
+#else
+  auto &bucket = parkingBucket(addr);
+  // waiters check the value with the bucket locked, so they can't miss this
+  { std::lock_guard<std::mutex> lock(bucket.mutex); }
+  bucket.cond.notify_all();
+#endif
+}
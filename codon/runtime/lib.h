@@ -16,6 +16,7 @@
 #define SEQ_FLAG_DEBUG (1 << 0)          // compiled/running in debug mode
 #define SEQ_FLAG_CAPTURE_OUTPUT (1 << 1) // capture writes to stdout/stderr
 #define SEQ_FLAG_STANDALONE (1 << 2)     // compiled as a standalone object/binary
+#define SEQ_FLAG_ALLOC_PROFILE (1 << 3)  // sample allocations for a heap profile
 
 #define SEQ_FUNC extern "C"
 
@@ -26,6 +27,32 @@ struct seq_str_t {
   char *str;
 };
 
+// Pointer layout of a type, emitted by the compiler for typed allocation
+struct seq_gc_layout_t {
+  uintptr_t descr;        // GC descriptor; computed on first use
+  seq_int_t size;         // element size in bytes
+  seq_int_t nwords;       // element size in words
+  const uint64_t *bitmap; // bit i set if word i of an element may be a pointer
+};
+
+#define SEQ_GC_PAUSE_BUCKETS 24
+
+// GC statistics; mirrored by gc.stats() in the stdlib
+struct seq_gc_stats_t {
+  seq_int_t heap_size;      // bytes in the GC heap, including free and unmapped
+  seq_int_t free_bytes;     // free bytes in the GC heap
+  seq_int_t unmapped_bytes; // bytes returned to the OS
+  seq_int_t bytes_since_gc; // bytes allocated since the last collection
+  seq_int_t total_bytes;    // bytes allocated since the program started
+  seq_int_t collections;    // number of collections
+  // the rest are only counted while stats are enabled
+  seq_int_t pauses;         // collections timed
+  seq_int_t pause_total_ns; // total time spent in them
+  seq_int_t pause_max_ns;   // longest of them
+  seq_int_t thread_bytes;   // bytes allocated by the calling thread
+  seq_int_t pause_hist[SEQ_GC_PAUSE_BUCKETS]; // bucket i: [2^i, 2^(i+1)) us
+};
+
 struct seq_time_t {
   int16_t year;
   int16_t yday;
@@ -61,15 +88,25 @@ SEQ_FUNC void *seq_alloc_atomic_uncollectable(size_t n);
 SEQ_FUNC void *seq_calloc(size_t m, size_t n);
 SEQ_FUNC void *seq_calloc_atomic(size_t m, size_t n);
 SEQ_FUNC void *seq_realloc(void *p, size_t newsize, size_t oldsize);
+SEQ_FUNC void *seq_alloc_typed(size_t n, seq_gc_layout_t *layout);
+SEQ_FUNC void *seq_realloc_typed(void *p, size_t newsize, size_t oldsize,
+                                 seq_gc_layout_t *layout);
 SEQ_FUNC void seq_free(void *p);
 SEQ_FUNC void seq_register_finalizer(void *p, void (*f)(void *obj, void *data));
 
+SEQ_FUNC void seq_gc_collect();
+SEQ_FUNC void seq_gc_stats_enable();
+SEQ_FUNC void seq_gc_stats(seq_gc_stats_t *stats);
 SEQ_FUNC void seq_gc_add_roots(void *start, void *end);
 SEQ_FUNC void seq_gc_remove_roots(void *start, void *end);
 SEQ_FUNC void seq_gc_clear_roots();
 SEQ_FUNC void seq_gc_exclude_static_roots(void *start, void *end);
 
 SEQ_FUNC void *seq_alloc_exc(int type, void *obj);
+SEQ_FUNC void seq_free_exc(void *exc);
+SEQ_FUNC void *seq_exc_capture();
+SEQ_FUNC void *seq_exc_obj(void *exc);
+SEQ_FUNC void seq_exc_rethrow(void *exc);
 SEQ_FUNC void seq_throw(void *exc);
 SEQ_FUNC _Unwind_Reason_Code seq_personality(int version, _Unwind_Action actions,
                                              uint64_t exceptionClass,
@@ -98,6 +135,25 @@ SEQ_FUNC void seq_lock_release(void *lock);
 SEQ_FUNC void *seq_rlock_new();
 SEQ_FUNC bool seq_rlock_acquire(void *lock, bool block, double timeout);
 SEQ_FUNC void seq_rlock_release(void *lock);
+SEQ_FUNC bool seq_futex_wait(int32_t *addr, int32_t val, double timeout);
+SEQ_FUNC void seq_futex_wake(int32_t *addr, seq_int_t n);
+
+SEQ_FUNC void seq_ws_spawn(seq_int_t *pending, void (*fn)(void *), void *arg);
+SEQ_FUNC void seq_ws_wait(seq_int_t *pending);
+SEQ_FUNC seq_int_t seq_ws_num_workers();
+SEQ_FUNC seq_int_t seq_ws_worker_id();
+SEQ_FUNC void *seq_pool_new(seq_int_t workers);
+SEQ_FUNC void seq_pool_submit(void *pool, void (*fn)(void *), void *arg);
+SEQ_FUNC bool seq_pool_help();
+SEQ_FUNC void seq_pool_shutdown(void *pool, bool wait);
+
+SEQ_FUNC void *seq_pipe_queue_new(seq_int_t capacity, seq_int_t producers);
+SEQ_FUNC void seq_pipe_queue_free(void *queue);
+SEQ_FUNC void seq_pipe_queue_push(void *queue, void *item);
+SEQ_FUNC void *seq_pipe_queue_pop(void *queue);
+SEQ_FUNC void seq_pipe_queue_close(void *queue);
+SEQ_FUNC void *seq_pipe_spawn(void (*fn)(void *), void *arg);
+SEQ_FUNC void seq_pipe_join(void *thread);
 
 namespace codon {
 namespace runtime {
@@ -132,5 +188,19 @@ std::string makeBacktraceFrameString(uintptr_t pc, const std::string &func = "",
 std::string getCapturedOutput();
 
 void setJITErrorCallback(std::function<void(const JITError &)> callback);
+
+struct SymbolizedFrame {
+  std::string func;
+  std::string file;
+  int line;
+};
+
+// Symbolizes pc into its frames, innermost (inlined) first; returns false if
+// pc is not in compiled code. Used for allocation profiles of JIT'd programs.
+void setAllocProfileSymbolizer(
+    std::function<bool(uintptr_t, std::vector<SymbolizedFrame> &)> symbolizer);
+
+// Writes the allocation profile, if enabled and not yet written.
+void writeAllocProfile();
 } // namespace runtime
 } // namespace codon
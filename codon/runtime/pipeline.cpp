@@ -0,0 +1,213 @@
+// Copyright (C) 2022-2023 Exaloop Inc. <https://exaloop.io>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <thread>
+
+#define GC_THREADS
+#include "codon/runtime/lib.h"
+#include <gc.h>
+
+/*
+ * Pipeline-parallel stages
+ *
+ * Stage groups of a pipeline run on their own threads and are connected
+ * by bounded multi-producer/multi-consumer queues. Items are pointers to
+ * GC-allocated boxes; a full queue blocks its producers (backpressure),
+ * and an empty one blocks its consumers until an item arrives or all of
+ * its producers have closed it.
+ */
+
+namespace {
+// failed attempts before a blocked producer or consumer goes to sleep
+constexpr int SPINS_BEFORE_SLEEP = 128;
+
+struct Cell {
+  std::atomic<size_t> seq;
+  void *data;
+};
+
+// Bounded MPMC queue by Dmitry Vyukov
+class Queue {
+  Cell *cells; // scanned by the GC, since it holds the only references to items
+  size_t mask;
+  alignas(64) std::atomic<size_t> head; // next position to push to
+  alignas(64) std::atomic<size_t> tail; // next position to pop from
+  alignas(64) std::atomic<int> producers;
+  std::atomic<int> waiters;
+  std::mutex lock;
+  std::condition_variable cond;
+
+  // Sleepers register in `waiters` before re-checking the queue, and
+  // wake() checks `waiters` after changing it, so one of them always
+  // sees the other.
+  void wake() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters.load() > 0) {
+      std::lock_guard<std::mutex> guard(lock);
+      cond.notify_all();
+    }
+  }
+
+public:
+  Queue(size_t capacity, int producers)
+      : cells(nullptr), mask(capacity - 1), head(0), tail(0), producers(producers),
+        waiters(0), lock(), cond() {
+    cells = static_cast<Cell *>(GC_MALLOC_UNCOLLECTABLE(capacity * sizeof(Cell)));
+    for (size_t i = 0; i < capacity; i++) {
+      new (&cells[i].seq) std::atomic<size_t>(i);
+      cells[i].data = nullptr;
+    }
+  }
+
+  ~Queue() { GC_FREE(cells); }
+
+  bool tryPush(void *data) {
+    size_t pos = head.load(std::memory_order_relaxed);
+    while (true) {
+      Cell *cell = &cells[pos & mask];
+      size_t seq = cell->seq.load(std::memory_order_acquire);
+      auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          cell->data = data;
+          cell->seq.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false; // full
+      } else {
+        pos = head.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool tryPop(void *&data) {
+    size_t pos = tail.load(std::memory_order_relaxed);
+    while (true) {
+      Cell *cell = &cells[pos & mask];
+      size_t seq = cell->seq.load(std::memory_order_acquire);
+      auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+      if (diff == 0) {
+        if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          data = cell->data;
+          cell->data = nullptr;
+          cell->seq.store(pos + mask + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false; // empty
+      } else {
+        pos = tail.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  void push(void *data) {
+    for (int i = 0; i < SPINS_BEFORE_SLEEP; i++) {
+      if (tryPush(data)) {
+        wake();
+        return;
+      }
+      std::this_thread::yield();
+    }
+
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      waiters.fetch_add(1);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      while (!tryPush(data))
+        cond.wait(guard);
+      waiters.fetch_sub(1);
+    }
+    wake();
+  }
+
+  // returns null once the queue is closed and drained
+  void *pop() {
+    void *data = nullptr;
+    for (int i = 0; i < SPINS_BEFORE_SLEEP; i++) {
+      if (tryPop(data)) {
+        wake();
+        return data;
+      }
+      if (producers.load() == 0)
+        return tryPop(data) ? data : nullptr;
+      std::this_thread::yield();
+    }
+
+    bool found = false;
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      waiters.fetch_add(1);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      while (!(found = tryPop(data)) && producers.load() != 0)
+        cond.wait(guard);
+      waiters.fetch_sub(1);
+    }
+    if (!found)
+      return tryPop(data) ? data : nullptr;
+    wake();
+    return data;
+  }
+
+  void close() {
+    if (producers.fetch_sub(1) == 1) {
+      std::lock_guard<std::mutex> guard(lock);
+      cond.notify_all();
+    }
+  }
+};
+
+struct Thunk {
+  void (*fn)(void *);
+  void *arg;
+};
+
+void runThunk(Thunk *thunk) {
+  GC_stack_base sb;
+  GC_get_stack_base(&sb);
+  GC_register_my_thread(&sb);
+  thunk->fn(thunk->arg);
+  GC_FREE(thunk);
+  GC_unregister_my_thread();
+}
+} // namespace
+
+SEQ_FUNC void *seq_pipe_queue_new(seq_int_t capacity, seq_int_t producers) {
+  size_t size = 2;
+  while (size < static_cast<size_t>(capacity))
+    size <<= 1;
+  return new Queue(size, static_cast<int>(producers));
+}
+
+SEQ_FUNC void seq_pipe_queue_free(void *queue) { delete static_cast<Queue *>(queue); }
+
+SEQ_FUNC void seq_pipe_queue_push(void *queue, void *item) {
+  static_cast<Queue *>(queue)->push(item);
+}
+
+SEQ_FUNC void *seq_pipe_queue_pop(void *queue) {
+  return static_cast<Queue *>(queue)->pop();
+}
+
+SEQ_FUNC void seq_pipe_queue_close(void *queue) {
+  static_cast<Queue *>(queue)->close();
+}
+
+SEQ_FUNC void *seq_pipe_spawn(void (*fn)(void *), void *arg) {
+  // keep the argument reachable until the thread is done with it
+  auto *thunk = static_cast<Thunk *>(GC_MALLOC_UNCOLLECTABLE(sizeof(Thunk)));
+  thunk->fn = fn;
+  thunk->arg = arg;
+  return new std::thread(runThunk, thunk);
+}
+
+SEQ_FUNC void seq_pipe_join(void *thread) {
+  auto *t = static_cast<std::thread *>(thread);
+  t->join();
+  delete t;
+}
@@ -1,14 +1,24 @@
 // Copyright (C) 2022-2023 Exaloop Inc. <https://exaloop.io>
 
-#include "codon/runtime/lib.h"
+#include <atomic>
 #include <cstring>
+#include <mutex>
+#include <new>
+#include <algorithm>
+#include <memory>
 #include <re2/re2.h>
+#include <re2/set.h>
+#include <shared_mutex>
 #include <string>
 #include <string_view>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
+#define GC_THREADS
+#include "codon/runtime/lib.h"
+#include <gc.h>
+
 using Regex = re2::RE2;
 using re2::StringPiece;
 
@@ -69,21 +79,6 @@ struct Span {
   seq_int_t end;
 };
 
-template <typename KV> struct GCMapAllocator : public std::allocator<KV> {
-  GCMapAllocator() = default;
-  GCMapAllocator(GCMapAllocator<KV> const &) = default;
-
-  template <typename KV1> GCMapAllocator(const GCMapAllocator<KV1> &) noexcept {}
-
-  KV *allocate(std::size_t n) { return (KV *)seq_alloc_uncollectable(n * sizeof(KV)); }
-
-  void deallocate(KV *p, std::size_t n) { seq_free(p); }
-
-  template <typename U> struct rebind {
-    using other = GCMapAllocator<U>;
-  };
-};
-
 static inline seq_str_t convert(const std::string &p) {
   seq_int_t n = p.size();
   auto *s = (char *)seq_alloc_atomic(n);
@@ -95,35 +90,201 @@ static inline StringPiece str2sp(const seq_str_t &s) {
   return StringPiece(s.str, s.len);
 }
 
-using Key = std::pair<seq_str_t, seq_int_t>;
+/*
+ * Compiled pattern cache
+ *
+ * RE2 objects are immutable and thread-safe, so compiled patterns are shared
+ * by all threads, in a cache split into shards by key. Each shard has a
+ * reader-writer lock, so that threads looking up cached patterns don't wait
+ * for each other, and holds a bounded number of patterns, evicted with the
+ * CLOCK approximation of LRU (a hit just marks its entry as referenced).
+ *
+ * Compiled patterns are GC objects, since Pattern objects refer to them
+ * directly: eviction only drops the cache's reference, and a finalizer
+ * destroys the RE2 object once nothing else refers to it either.
+ */
 
-struct KeyEqual {
-  bool operator()(const Key &a, const Key &b) const {
-    return a.second == b.second && str2sp(a.first) == str2sp(b.first);
-  }
-};
+namespace {
+constexpr size_t NUM_SHARDS = 16;
+constexpr size_t CACHE_SIZE = 512; // as in CPython's re module
+constexpr size_t SHARD_SIZE = CACHE_SIZE / NUM_SHARDS;
+
+using Key = std::pair<std::string_view, seq_int_t>;
 
 struct KeyHash {
   std::size_t operator()(const Key &k) const {
-    using sv = std::string_view;
-    return std::hash<sv>()(sv(k.first.str, k.first.len)) ^ k.second;
+    return std::hash<std::string_view>()(k.first) ^ k.second;
+  }
+};
+
+struct Entry {
+  std::string pattern; // owned copy, which the index's key refers to
+  seq_int_t flags = 0;
+  std::atomic<bool> referenced{false};
+};
+
+struct Shard {
+  std::shared_mutex lock;
+  std::unordered_map<Key, size_t, KeyHash> index; // key -> slot
+  Entry entries[SHARD_SIZE];
+  Regex **regexes; // uncollectable, so that the GC sees cached patterns
+  size_t size = 0;
+  size_t hand = 0; // CLOCK hand
+  std::atomic<seq_int_t> hits{0};
+  std::atomic<seq_int_t> misses{0};
+
+  Shard()
+      : regexes(static_cast<Regex **>(
+            GC_MALLOC_UNCOLLECTABLE(SHARD_SIZE * sizeof(Regex *)))) {}
+
+  // picks a slot for a new pattern, evicting one if full; lock held
+  size_t claim() {
+    if (size < SHARD_SIZE)
+      return size++;
+    while (true) {
+      size_t slot = hand;
+      hand = (hand + 1) % SHARD_SIZE;
+      if (entries[slot].referenced.exchange(false, std::memory_order_relaxed))
+        continue;
+      index.erase(Key(entries[slot].pattern, entries[slot].flags));
+      return slot;
+    }
   }
 };
 
-static thread_local std::unordered_map<const Key, Regex, KeyHash, KeyEqual,
-                                       GCMapAllocator<std::pair<const Key, Regex>>>
-    cache;
+// created on first use, after the GC has been initialized
+Shard *getShards() {
+  static Shard *shards = new Shard[NUM_SHARDS];
+  return shards;
+}
+
+void finalizeRegex(void *obj, void *data) { static_cast<Regex *>(obj)->~RE2(); }
+
+Regex *compileRegex(const seq_str_t &p, seq_int_t flags) {
+  // not seq_alloc_atomic, which could allocate from an arena
+  auto *re = new (GC_MALLOC_ATOMIC(sizeof(Regex))) Regex(str2sp(p), flags2opt(flags));
+  GC_REGISTER_FINALIZER(re, finalizeRegex, nullptr, nullptr, nullptr);
+  return re;
+}
+} // namespace
 
 static inline Regex *get(const seq_str_t &p, seq_int_t flags) {
-  auto key = std::make_pair(p, flags);
-  auto it = cache.find(key);
-  if (it == cache.end()) {
-    auto result = cache.emplace(std::piecewise_construct, std::forward_as_tuple(key),
-                                std::forward_as_tuple(str2sp(p), flags2opt(flags)));
-    return &result.first->second;
-  } else {
-    return &it->second;
+  Key key(std::string_view(p.str, p.len), flags);
+  auto &shard = getShards()[KeyHash()(key) % NUM_SHARDS];
+  {
+    std::shared_lock<std::shared_mutex> guard(shard.lock);
+    auto it = shard.index.find(key);
+    if (it != shard.index.end()) {
+      auto &entry = shard.entries[it->second];
+      if (!entry.referenced.load(std::memory_order_relaxed))
+        entry.referenced.store(true, std::memory_order_relaxed);
+      shard.hits.fetch_add(1, std::memory_order_relaxed);
+      return shard.regexes[it->second];
+    }
   }
+
+  // compile without holding the lock; if another thread beats us to it, this
+  // copy is left to the GC
+  auto *re = compileRegex(p, flags);
+  std::unique_lock<std::shared_mutex> guard(shard.lock);
+  shard.misses.fetch_add(1, std::memory_order_relaxed);
+  auto it = shard.index.find(key);
+  if (it != shard.index.end())
+    return shard.regexes[it->second];
+
+  size_t slot = shard.claim();
+  auto &entry = shard.entries[slot];
+  entry.pattern.assign(p.str, p.len);
+  entry.flags = flags;
+  entry.referenced.store(false, std::memory_order_relaxed);
+  shard.regexes[slot] = re;
+  shard.index.emplace(Key(entry.pattern, flags), slot);
+  return re;
+}
+
+/*
+ * Pattern sets
+ *
+ * A pattern set finds which of its patterns match a string in a single pass
+ * with RE2::Set, instead of one search per pattern. The RE2::Set for each
+ * kind of anchoring is compiled on first use; patterns are validated as they
+ * are added. Like compiled patterns, sets are GC objects with finalizers.
+ */
+
+namespace {
+struct PatternSet {
+  Regex::Options options;
+  std::vector<std::string> patterns;
+  std::once_flag compiled[3]; // by anchor
+  std::unique_ptr<Regex::Set> sets[3];
+
+  explicit PatternSet(seq_int_t flags) : options(flags2opt(flags)) {}
+
+  const Regex::Set &get(seq_int_t anchor) {
+    std::call_once(compiled[anchor], [this, anchor]() {
+      auto set =
+          std::make_unique<Regex::Set>(options, static_cast<Regex::Anchor>(anchor));
+      for (const auto &pattern : patterns)
+        set->Add(pattern, /*error=*/nullptr);
+      set->Compile();
+      sets[anchor] = std::move(set);
+    });
+    return *sets[anchor];
+  }
+
+  // indices of matching patterns, sorted; false if RE2 ran out of memory
+  bool match(seq_int_t anchor, const seq_str_t &s, std::vector<int> &matches) {
+    if (patterns.empty())
+      return true;
+    Regex::Set::ErrorInfo info;
+    if (!get(anchor).Match(str2sp(s), &matches, &info))
+      return info.kind == Regex::Set::kNoError;
+    std::sort(matches.begin(), matches.end());
+    return true;
+  }
+};
+
+void finalizeSet(void *obj, void *data) {
+  static_cast<PatternSet *>(obj)->~PatternSet();
+}
+} // namespace
+
+SEQ_FUNC void *seq_re_set_new(seq_int_t flags) {
+  auto *set = new (GC_MALLOC_ATOMIC(sizeof(PatternSet))) PatternSet(flags);
+  GC_REGISTER_FINALIZER(set, finalizeSet, nullptr, nullptr, nullptr);
+  return set;
+}
+
+// adds a pattern before the set is first used; returns an error message if
+// the pattern is invalid
+SEQ_FUNC seq_str_t seq_re_set_add(PatternSet *set, seq_str_t p) {
+  Regex re(str2sp(p), set->options);
+  if (!re.ok())
+    return convert(re.error());
+  set->patterns.emplace_back(p.str, p.len);
+  return {0, nullptr};
+}
+
+// returns the number of matching patterns followed by their indices, or null
+// if RE2 ran out of memory
+SEQ_FUNC seq_int_t *seq_re_set_match(PatternSet *set, seq_int_t anchor, seq_str_t s) {
+  std::vector<int> matches;
+  if (!set->match(anchor, s, matches))
+    return nullptr;
+  auto *out = (seq_int_t *)seq_alloc_atomic((matches.size() + 1) * sizeof(seq_int_t));
+  out[0] = static_cast<seq_int_t>(matches.size());
+  std::copy(matches.begin(), matches.end(), out + 1);
+  return out;
+}
+
+// returns the index of the first matching pattern, -1 if none matches or -2
+// if RE2 ran out of memory
+SEQ_FUNC seq_int_t seq_re_set_match_first(PatternSet *set, seq_int_t anchor,
+                                          seq_str_t s) {
+  std::vector<int> matches;
+  if (!set->match(anchor, s, matches))
+    return -2;
+  return matches.empty() ? -1 : matches.front();
 }
 
 /*
@@ -178,7 +339,32 @@ SEQ_FUNC seq_str_t seq_re_escape(seq_str_t p) {
 
 SEQ_FUNC Regex *seq_re_compile(seq_str_t p, seq_int_t flags) { return get(p, flags); }
 
-SEQ_FUNC void seq_re_purge() { cache.clear(); }
+SEQ_FUNC void seq_re_purge() {
+  auto *shards = getShards();
+  for (size_t i = 0; i < NUM_SHARDS; i++) {
+    auto &shard = shards[i];
+    std::unique_lock<std::shared_mutex> guard(shard.lock);
+    shard.index.clear();
+    for (size_t slot = 0; slot < shard.size; slot++)
+      shard.regexes[slot] = nullptr;
+    shard.size = 0;
+    shard.hand = 0;
+  }
+}
+
+// hits, misses, maximum size and current size of the cache
+SEQ_FUNC void seq_re_cache_info(seq_int_t *info) {
+  auto *shards = getShards();
+  info[0] = info[1] = info[3] = 0;
+  info[2] = NUM_SHARDS * SHARD_SIZE;
+  for (size_t i = 0; i < NUM_SHARDS; i++) {
+    auto &shard = shards[i];
+    std::shared_lock<std::shared_mutex> guard(shard.lock);
+    info[0] += shard.hits.load(std::memory_order_relaxed);
+    info[1] += shard.misses.load(std::memory_order_relaxed);
+    info[3] += shard.size;
+  }
+}
 
 /*
  * Pattern methods
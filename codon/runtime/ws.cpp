@@ -0,0 +1,511 @@
+// Copyright (C) 2022-2023 Exaloop Inc. <https://exaloop.io>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+#define GC_THREADS
+#include "codon/runtime/lib.h"
+#include <gc.h>
+
+/*
+ * Work-stealing task runtime
+ *
+ * Each participating thread owns a Chase-Lev deque: it pushes and pops tasks
+ * at the bottom, while idle threads steal from the top of other threads'
+ * deques. Worker threads are started lazily and registered with the GC. Any
+ * other thread that spawns tasks (the main thread, OpenMP threads, ...) gets
+ * a deque of its own when it first does so, and helps run tasks while it
+ * waits for them.
+ */
+
+namespace {
+typedef void (*ws_task_fn)(void *);
+
+struct Task {
+  ws_task_fn fn;
+  void *arg;
+  seq_int_t *pending; // group counter, decremented once the task has run
+};
+
+// Deque storage holds the only references to queued tasks, so it is
+// allocated as uncollectable (i.e. scanned but not collected) GC memory,
+// and freed by its deque.
+struct TaskArray {
+  int64_t size;
+  std::atomic<Task *> tasks[1];
+
+  static TaskArray *make(int64_t size) {
+    auto *mem = GC_MALLOC_UNCOLLECTABLE(sizeof(TaskArray) +
+                                        (size - 1) * sizeof(std::atomic<Task *>));
+    auto *array = static_cast<TaskArray *>(mem);
+    array->size = size;
+    for (int64_t i = 0; i < size; i++)
+      new (&array->tasks[i]) std::atomic<Task *>(nullptr);
+    return array;
+  }
+
+  Task *get(int64_t i) {
+    return tasks[i & (size - 1)].load(std::memory_order_acquire);
+  }
+
+  void put(int64_t i, Task *task) {
+    tasks[i & (size - 1)].store(task, std::memory_order_release);
+  }
+
+  // Drops the array's reference to a taken task, unless the slot has
+  // since been reused for another one.
+  void clear(int64_t i, Task *task) {
+    tasks[i & (size - 1)].compare_exchange_strong(task, nullptr,
+                                                  std::memory_order_relaxed);
+  }
+};
+
+// Chase-Lev deque, following "Correct and Efficient Work-Stealing for Weak
+// Memory Models" (Le et al., PPoPP 2013). Slots are cleared once their task
+// is taken, so the GC can reclaim tasks (and their arguments) that have run.
+class Deque {
+  std::atomic<int64_t> top;
+  std::atomic<int64_t> bottom;
+  std::atomic<TaskArray *> array;
+  // thieves currently in steal(), which might be reading a replaced array
+  std::atomic<int> thieves;
+  // arrays replaced by grow(), freed once no thief can be reading them
+  std::vector<TaskArray *> retired;
+
+  TaskArray *grow(TaskArray *old, int64_t b, int64_t t) {
+    auto *array = TaskArray::make(old->size * 2);
+    for (int64_t i = t; i < b; i++)
+      array->put(i, old->get(i));
+    retired.push_back(old);
+    this->array.store(array, std::memory_order_release);
+    return array;
+  }
+
+  // Thieves that enter steal() after the array was replaced load the new
+  // one, so the retired arrays can be freed if no thief is active now.
+  void reclaim() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (thieves.load(std::memory_order_acquire) != 0)
+      return;
+    for (auto *a : retired)
+      GC_FREE(a);
+    retired.clear();
+  }
+
+public:
+  explicit Deque(int64_t size = 256)
+      : top(0), bottom(0), array(TaskArray::make(size)), thieves(0), retired() {}
+
+  ~Deque() {
+    GC_FREE(array.load());
+    for (auto *a : retired)
+      GC_FREE(a);
+  }
+
+  // owner only
+  void push(Task *task) {
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    int64_t t = top.load(std::memory_order_acquire);
+    auto *a = array.load(std::memory_order_relaxed);
+    if (b - t > a->size - 1)
+      a = grow(a, b, t);
+    a->put(b, task);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom.store(b + 1, std::memory_order_relaxed);
+    if (!retired.empty())
+      reclaim();
+  }
+
+  // owner only
+  Task *pop() {
+    int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    auto *a = array.load(std::memory_order_relaxed);
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_relaxed);
+
+    if (t > b) {
+      bottom.store(b + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+
+    Task *task = a->get(b);
+    if (t == b) {
+      // last task; race against thieves for it
+      if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                       std::memory_order_relaxed))
+        task = nullptr;
+      bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    if (task)
+      a->clear(b, task);
+    return task;
+  }
+
+  // any thread
+  Task *steal() {
+    thieves.fetch_add(1, std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom.load(std::memory_order_acquire);
+    Task *task = nullptr;
+    if (t < b) {
+      auto *a = array.load(std::memory_order_acquire);
+      task = a->get(t);
+      if (top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed)) {
+        a->clear(t, task);
+        // the owner might have copied the task to a new array meanwhile
+        auto *current = array.load(std::memory_order_acquire);
+        if (current != a)
+          current->clear(t, task);
+      } else {
+        task = nullptr;
+      }
+    }
+    thieves.fetch_sub(1, std::memory_order_release);
+    return task;
+  }
+};
+
+// upper bound on the number of threads that can own a deque
+constexpr int MAX_SLOTS = 512;
+// failed steal rounds before an idle worker goes to sleep
+constexpr int SPINS_BEFORE_SLEEP = 64;
+
+struct Scheduler {
+  std::atomic<Deque *> slots[MAX_SLOTS];
+  std::atomic<int> numSlots;
+  int numWorkers;
+
+  std::mutex sleepLock;
+  std::condition_variable sleepCond;
+  std::atomic<int> sleepers;
+  std::atomic<uint64_t> pushes;
+
+  Scheduler() : numSlots(0), numWorkers(1), sleepers(0), pushes(0) {
+    for (auto &slot : slots)
+      slot.store(nullptr, std::memory_order_relaxed);
+  }
+};
+
+Scheduler *scheduler = nullptr;
+std::once_flag schedulerInit;
+
+thread_local Deque *localDeque = nullptr;
+thread_local int localSlot = -1;
+thread_local uint64_t localRand = 0;
+
+int getNumWorkers() {
+  int n = 0;
+  for (const char *var : {"CODON_WS_NUM_THREADS", "OMP_NUM_THREADS"}) {
+    if (const char *s = std::getenv(var)) {
+      n = std::atoi(s);
+      if (n > 0)
+        break;
+    }
+  }
+  if (n <= 0)
+    n = static_cast<int>(std::thread::hardware_concurrency());
+  // leave room for other threads that spawn tasks
+  return std::max(1, std::min(n, MAX_SLOTS / 2));
+}
+
+// Gives the calling thread a deque; returns false if all slots are taken.
+bool attach() {
+  if (localDeque)
+    return true;
+  int slot = scheduler->numSlots.fetch_add(1);
+  if (slot >= MAX_SLOTS)
+    return false;
+  localDeque = new Deque();
+  localSlot = slot;
+  localRand = 0x9e3779b97f4a7c15ULL * (slot + 1);
+  scheduler->slots[slot].store(localDeque, std::memory_order_release);
+  return true;
+}
+
+uint64_t nextRand() {
+  // xorshift64
+  localRand ^= localRand << 13;
+  localRand ^= localRand >> 7;
+  localRand ^= localRand << 17;
+  return localRand;
+}
+
+Task *findTask() {
+  if (auto *task = localDeque->pop())
+    return task;
+
+  int n = std::min(scheduler->numSlots.load(std::memory_order_acquire), MAX_SLOTS);
+  int start = static_cast<int>(nextRand() % n);
+  for (int i = 0; i < n; i++) {
+    int victim = (start + i) % n;
+    if (victim == localSlot)
+      continue;
+    if (auto *deque = scheduler->slots[victim].load(std::memory_order_acquire)) {
+      if (auto *task = deque->steal())
+        return task;
+    }
+  }
+  return nullptr;
+}
+
+void run(Task *task) {
+  task->fn(task->arg);
+  __atomic_fetch_sub(task->pending, 1, __ATOMIC_ACQ_REL);
+}
+
+void workerLoop() {
+  GC_stack_base sb;
+  GC_get_stack_base(&sb);
+  GC_register_my_thread(&sb);
+  attach();
+
+  int idle = 0;
+  while (true) {
+    uint64_t seen = scheduler->pushes.load();
+    if (auto *task = findTask()) {
+      run(task);
+      idle = 0;
+      continue;
+    }
+
+    if (++idle < SPINS_BEFORE_SLEEP) {
+      std::this_thread::yield();
+      continue;
+    }
+
+    scheduler->sleepers.fetch_add(1);
+    {
+      std::unique_lock<std::mutex> lock(scheduler->sleepLock);
+      scheduler->sleepCond.wait(lock,
+                                [seen] { return scheduler->pushes.load() != seen; });
+    }
+    scheduler->sleepers.fetch_sub(1);
+    idle = 0;
+  }
+}
+
+void init() {
+  scheduler = new Scheduler();
+  scheduler->numWorkers = getNumWorkers();
+  // the thread initializing the runtime participates too
+  attach();
+  for (int i = 1; i < scheduler->numWorkers; i++)
+    std::thread(workerLoop).detach();
+}
+
+void ensureInit() { std::call_once(schedulerInit, init); }
+
+/*
+ * Thread pools
+ *
+ * Executors from concurrent.futures get pools of their own rather than
+ * sharing the scheduler's workers, since their tasks may block (on I/O,
+ * locks, other futures, ...) and should not hold up parallel loops. Each
+ * worker owns a deque for the tasks it submits itself; other threads submit
+ * to a shared queue, which workers steal from in FIFO order along with each
+ * other's deques.
+ */
+struct Pool {
+  std::vector<Deque *> deques; // one per worker
+  Deque injected;              // pushed to under lock, by non-workers
+  std::vector<std::thread> threads;
+  seq_int_t pending;
+
+  std::mutex lock;
+  std::condition_variable cond;
+  std::atomic<int> sleepers;
+  std::atomic<uint64_t> pushes;
+  std::atomic<bool> stopping;
+  // workers plus the owner; the last to let go deletes the pool
+  std::atomic<int> refs;
+
+  explicit Pool(int numWorkers)
+      : deques(), injected(), threads(), pending(0), lock(), cond(), sleepers(0),
+        pushes(0), stopping(false), refs(numWorkers + 1) {
+    for (int i = 0; i < numWorkers; i++)
+      deques.push_back(new Deque());
+  }
+
+  ~Pool() {
+    for (auto *deque : deques)
+      delete deque;
+  }
+
+  void release() {
+    if (refs.fetch_sub(1) == 1)
+      delete this;
+  }
+};
+
+thread_local Pool *localPool = nullptr;
+thread_local int localPoolIndex = -1;
+
+Task *findPoolTask(Pool *pool, int index) {
+  if (auto *task = pool->deques[index]->pop())
+    return task;
+  if (auto *task = pool->injected.steal())
+    return task;
+
+  int n = static_cast<int>(pool->deques.size());
+  int start = static_cast<int>(nextRand() % n);
+  for (int i = 0; i < n; i++) {
+    int victim = (start + i) % n;
+    if (victim == index)
+      continue;
+    if (auto *task = pool->deques[victim]->steal())
+      return task;
+  }
+  return nullptr;
+}
+
+void poolWorkerLoop(Pool *pool, int index) {
+  GC_stack_base sb;
+  GC_get_stack_base(&sb);
+  GC_register_my_thread(&sb);
+  localPool = pool;
+  localPoolIndex = index;
+  localRand = 0xbf58476d1ce4e5b9ULL * (index + 1);
+
+  int idle = 0;
+  while (true) {
+    uint64_t seen = pool->pushes.load();
+    if (auto *task = findPoolTask(pool, index)) {
+      run(task);
+      idle = 0;
+      continue;
+    }
+
+    // tasks submitted before shutdown still run
+    if (pool->stopping.load()) {
+      if (auto *task = findPoolTask(pool, index)) {
+        run(task);
+        continue;
+      }
+      break;
+    }
+
+    if (++idle < SPINS_BEFORE_SLEEP) {
+      std::this_thread::yield();
+      continue;
+    }
+
+    pool->sleepers.fetch_add(1);
+    {
+      std::unique_lock<std::mutex> lock(pool->lock);
+      pool->cond.wait(lock, [pool, seen] {
+        return pool->pushes.load() != seen || pool->stopping.load();
+      });
+    }
+    pool->sleepers.fetch_sub(1);
+    idle = 0;
+  }
+
+  localPool = nullptr;
+  localPoolIndex = -1;
+  GC_unregister_my_thread();
+  pool->release();
+}
+} // namespace
+
+SEQ_FUNC void seq_ws_spawn(seq_int_t *pending, void (*fn)(void *), void *arg) {
+  ensureInit();
+  __atomic_fetch_add(pending, 1, __ATOMIC_RELAXED);
+  if (!attach()) {
+    // too many threads; just run the task here
+    run(new (GC_MALLOC(sizeof(Task))) Task{fn, arg, pending});
+    return;
+  }
+
+  localDeque->push(new (GC_MALLOC(sizeof(Task))) Task{fn, arg, pending});
+  scheduler->pushes.fetch_add(1);
+  if (scheduler->sleepers.load() > 0) {
+    std::lock_guard<std::mutex> lock(scheduler->sleepLock);
+    scheduler->sleepCond.notify_one();
+  }
+}
+
+SEQ_FUNC void seq_ws_wait(seq_int_t *pending) {
+  if (__atomic_load_n(pending, __ATOMIC_ACQUIRE) == 0)
+    return;
+  ensureInit();
+  attach();
+  // help out until all of the group's tasks have run
+  while (__atomic_load_n(pending, __ATOMIC_ACQUIRE) != 0) {
+    if (auto *task = localDeque ? findTask() : nullptr)
+      run(task);
+    else
+      std::this_thread::yield();
+  }
+}
+
+SEQ_FUNC seq_int_t seq_ws_num_workers() {
+  ensureInit();
+  return scheduler->numWorkers;
+}
+
+SEQ_FUNC seq_int_t seq_ws_worker_id() { return localSlot < 0 ? 0 : localSlot; }
+
+SEQ_FUNC void *seq_pool_new(seq_int_t workers) {
+  int n = static_cast<int>(std::max<seq_int_t>(1, workers));
+  auto *pool = new Pool(n);
+  for (int i = 0; i < n; i++)
+    pool->threads.emplace_back(poolWorkerLoop, pool, i);
+  return pool;
+}
+
+SEQ_FUNC void seq_pool_submit(void *p, void (*fn)(void *), void *arg) {
+  auto *pool = static_cast<Pool *>(p);
+  __atomic_fetch_add(&pool->pending, 1, __ATOMIC_RELAXED);
+  auto *task = new (GC_MALLOC(sizeof(Task))) Task{fn, arg, &pool->pending};
+  if (localPool == pool) {
+    pool->deques[localPoolIndex]->push(task);
+  } else {
+    std::lock_guard<std::mutex> lock(pool->lock);
+    pool->injected.push(task);
+  }
+
+  pool->pushes.fetch_add(1);
+  if (pool->sleepers.load() > 0) {
+    std::lock_guard<std::mutex> lock(pool->lock);
+    pool->cond.notify_one();
+  }
+}
+
+// Runs one of the pool's tasks if called from one of its workers, so that
+// workers waiting on futures make progress instead of tying up the pool.
+SEQ_FUNC bool seq_pool_help() {
+  if (!localPool)
+    return false;
+  auto *task = findPoolTask(localPool, localPoolIndex);
+  if (!task)
+    return false;
+  run(task);
+  return true;
+}
+
+SEQ_FUNC void seq_pool_shutdown(void *p, bool wait) {
+  auto *pool = static_cast<Pool *>(p);
+  {
+    std::lock_guard<std::mutex> lock(pool->lock);
+    pool->stopping.store(true);
+    pool->cond.notify_all();
+  }
+  for (auto &thread : pool->threads) {
+    // a worker shutting down its own pool can't wait for itself
+    if (wait && thread.get_id() != std::this_thread::get_id())
+      thread.join();
+    else
+      thread.detach();
+  }
+  pool->release();
+}
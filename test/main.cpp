@@ -7,16 +7,25 @@
 #include <fstream>
 #include <gc.h>
 #include <iostream>
+#include <memory>
 #include <sstream>
 #include <string>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <tuple>
 #include <unistd.h>
+#include <unordered_map>
 #include <vector>
 
 #include "codon/cir/analyze/dataflow/capture.h"
+#include "codon/cir/analyze/dataflow/cfg.h"
 #include "codon/cir/analyze/dataflow/reaching.h"
+#include "codon/cir/analyze/module/global_vars.h"
+#include "codon/cir/analyze/module/side_effect.h"
+#include "codon/cir/transform/lowering/pipeline.h"
+#include "codon/cir/transform/parallel/autopar.h"
+#include "codon/cir/transform/parallel/openmp.h"
+#include "codon/cir/transform/polymorphism/devirtualize.h"
 #include "codon/cir/util/inlining.h"
 #include "codon/cir/util/irtools.h"
 #include "codon/cir/util/operator.h"
@@ -181,6 +190,96 @@ struct EscapeValidator : public ir::transform::Pass {
   }
 };
 
+struct CountVirtualCalls : public ir::util::Operator {
+  int count = 0;
+  std::vector<ir::CallInstr *> markers;
+
+  void handle(ir::CallInstr *v) override {
+    using namespace codon::ir;
+    if (util::isCallOf(v, "__devirtualized__")) {
+      markers.push_back(v);
+      return;
+    }
+    // Function[T, R](__internal__.class_get_rtti_vtable(obj)[id])(obj, ...)
+    auto *fnNew = cast<CallInstr>(v->getCallee());
+    if (!fnNew || !util::isCallOf(fnNew, Module::NEW_MAGIC_NAME, 1))
+      return;
+    auto *slot = cast<CallInstr>(fnNew->front());
+    if (slot && util::isCallOf(slot, Module::GETITEM_MAGIC_NAME, 2) &&
+        util::isCallOf(slot->front(), "class_get_rtti_vtable", 1))
+      ++count;
+  }
+};
+
+/// Counts the virtual calls in each function before and after
+/// devirtualization, and replaces calls to __devirtualized__() with
+/// the number of virtual calls removed from the calling function.
+class TestDevirtualizer : public ir::transform::Pass {
+  std::shared_ptr<std::unordered_map<ir::id_t, int>> before;
+  bool after;
+
+public:
+  TestDevirtualizer(std::shared_ptr<std::unordered_map<ir::id_t, int>> before,
+                    bool after)
+      : ir::transform::Pass(), before(std::move(before)), after(after) {}
+
+  std::string getKey() const override {
+    return after ? "test-devirtualizer-after-pass" : "test-devirtualizer-before-pass";
+  }
+
+  void run(ir::Module *m) override {
+    using namespace codon::ir;
+    for (auto *var : *m) {
+      if (auto *f = cast<Func>(var)) {
+        CountVirtualCalls cvc;
+        f->accept(cvc);
+        if (!after) {
+          (*before)[f->getId()] = cvc.count;
+          continue;
+        }
+        for (auto *marker : cvc.markers)
+          marker->replaceAll(m->getInt((*before)[f->getId()] - cvc.count));
+      }
+    }
+  }
+};
+
+/// Replaces calls to expect_auto_par(parallelized, reason) with whether
+/// the automatic parallelization report entry for the closest loop above
+/// the call has that decision, with a reason containing the given text.
+class TestAutoParReport : public ir::transform::OperatorPass {
+  const ir::transform::parallel::AutoParallelizationPass *autoPar;
+
+public:
+  explicit TestAutoParReport(
+      const ir::transform::parallel::AutoParallelizationPass *autoPar)
+      : ir::transform::OperatorPass(), autoPar(autoPar) {}
+
+  std::string getKey() const override { return "test-auto-par-report-pass"; }
+
+  void handle(ir::CallInstr *v) override {
+    using namespace codon::ir;
+    if (!util::isCallOf(v, "expect_auto_par"))
+      return;
+    std::vector<Value *> args(v->begin(), v->end());
+    seqassertn(args.size() == 2 && isA<BoolConst>(args[0]) &&
+                   isA<StringConst>(args[1]),
+               "bad auto-par-test call");
+
+    auto src = v->getSrcInfo();
+    const transform::parallel::AutoParallelizationPass::LoopReport *entry = nullptr;
+    for (auto &e : autoPar->getReport()) {
+      if (e.src.file == src.file && e.src.line < src.line &&
+          (!entry || e.src.line > entry->src.line))
+        entry = &e;
+    }
+    bool good = entry && entry->parallelized == cast<BoolConst>(args[0])->getVal() &&
+                entry->reason.find(cast<StringConst>(args[1])->getVal()) !=
+                    std::string::npos;
+    v->replaceAll(v->getModule()->getBool(good));
+  }
+};
+
 vector<string> splitLines(const string &output) {
   vector<string> result;
   string line;
@@ -299,6 +398,29 @@ public:
                                 ir::analyze::dataflow::DominatorAnalysis::KEY});
       pm->registerPass(std::make_unique<EscapeValidator>(capKey), /*insertBefore=*/"",
                        {capKey});
+      if (get<0>(GetParam()) == "transform/auto_par.codon") {
+        using namespace ir::analyze;
+        using namespace ir::transform::parallel;
+        auto autoPar = std::make_unique<AutoParallelizationPass>(
+            module::SideEffectAnalysis::KEY, /*minWork=*/50000, /*printReport=*/false);
+        auto *report = autoPar.get();
+        pm->registerPass(std::move(autoPar), /*insertBefore=*/OpenMPPass::KEY,
+                         {module::SideEffectAnalysis::KEY},
+                         {dataflow::CFAnalysis::KEY, module::GlobalVarsAnalyses::KEY});
+        pm->registerPass(std::make_unique<TestAutoParReport>(report));
+      }
+      if (get<0>(GetParam()) == "transform/devirtualize.codon") {
+        using namespace ir::transform::polymorphism;
+        auto counts = std::make_shared<std::unordered_map<ir::id_t, int>>();
+        pm->registerPass(std::make_unique<TestDevirtualizer>(counts, /*after=*/false),
+                         /*insertBefore=*/DevirtualizationPass::KEY);
+        pm->registerPass(std::make_unique<TestDevirtualizer>(counts, /*after=*/true));
+      }
+      if (get<0>(GetParam()) == "transform/pipeline_stages.codon") {
+        using namespace ir::transform::lowering;
+        auto *pass = pm->getPass(PipelineLowering::KEY);
+        static_cast<PipelineLowering *>(pass)->setStaged(/*workers=*/2, /*size=*/4);
+      }
 
       llvm::cantFail(compiler->compile());
       compiler->getLLVMVisitor()->run({file});
@@ -369,6 +491,252 @@ TEST_P(SeqTest, Run) {
     EXPECT_EQ(results.size(), expects.first.size());
   }
 }
+// Fields of a protocol buffer message, enough to read back pprof profiles
+struct ProtoField {
+  int field;
+  uint64_t value; // for varints
+  string bytes;   // for length-delimited fields
+};
+
+static uint64_t readVarint(const string &buf, size_t &pos) {
+  uint64_t v = 0;
+  for (int shift = 0; pos < buf.size(); shift += 7) {
+    auto b = static_cast<unsigned char>(buf[pos++]);
+    v |= static_cast<uint64_t>(b & 0x7f) << shift;
+    if (!(b & 0x80))
+      break;
+  }
+  return v;
+}
+
+static vector<ProtoField> readProto(const string &buf) {
+  vector<ProtoField> fields;
+  size_t pos = 0;
+  while (pos < buf.size()) {
+    auto key = readVarint(buf, pos);
+    ProtoField f{static_cast<int>(key >> 3), 0, ""};
+    if ((key & 7) == 2) {
+      auto n = readVarint(buf, pos);
+      f.bytes = buf.substr(pos, n);
+      pos += n;
+    } else {
+      f.value = readVarint(buf, pos);
+    }
+    fields.push_back(f);
+  }
+  return fields;
+}
+
+static vector<uint64_t> readPacked(const string &buf) {
+  vector<uint64_t> vs;
+  size_t pos = 0;
+  while (pos < buf.size())
+    vs.push_back(readVarint(buf, pos));
+  return vs;
+}
+
+TEST(AllocProfileTest, WritesSymbolizedProfile) {
+  const string source = "alloc_profile.codon";
+  const string code = "def make_lists(n: int):\n"
+                      "    total = 0\n"
+                      "    for i in range(n):\n"
+                      "        v = [j for j in range(1000)]\n"
+                      "        total += len(v)\n"
+                      "    return total\n"
+                      "print(make_lists(10000))\n";
+  char path[] = "/tmp/codon-alloc-XXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_NE(fd, -1);
+  close(fd);
+  unlink(path);
+
+  // same as running with -alloc-profile and CODON_ALLOC_PROFILE set
+  pid_t pid = fork();
+  GC_atfork_prepare();
+  ASSERT_NE(pid, -1);
+  if (pid == 0) {
+    GC_atfork_child();
+    setenv("CODON_ALLOC_PROFILE", path, 1);
+    auto compiler = std::make_unique<Compiler>(argv0, /*debug=*/false);
+    compiler->getLLVMVisitor()->setStandalone(true);
+    compiler->getLLVMVisitor()->setAllocProfile(true);
+    llvm::cantFail(compiler->parseCode(source, code));
+    llvm::cantFail(compiler->compile());
+    compiler->getLLVMVisitor()->run({source});
+    fflush(stdout);
+    exit(EXIT_SUCCESS);
+  }
+  GC_atfork_parent();
+  int status = -1;
+  ASSERT_EQ(waitpid(pid, &status, 0), pid);
+  ASSERT_TRUE(WIFEXITED(status));
+  ASSERT_EQ(WEXITSTATUS(status), 0);
+
+  ifstream in(path, ios::binary);
+  ASSERT_TRUE(in.good()) << "profile not written to " << path;
+  string profile((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+  in.close();
+  unlink(path);
+
+  vector<string> strings;
+  unordered_map<uint64_t, pair<string, string>> functions; // id -> (name, file)
+  unordered_map<uint64_t, vector<uint64_t>> locations;     // id -> function ids
+  vector<ProtoField> samples;
+  for (auto &f : readProto(profile)) {
+    if (f.field == 2) {
+      samples.push_back(f);
+    } else if (f.field == 6) {
+      strings.push_back(f.bytes);
+    }
+  }
+  for (auto &f : readProto(profile)) {
+    if (f.field == 4) {
+      uint64_t id = 0;
+      vector<uint64_t> funcs;
+      for (auto &g : readProto(f.bytes)) {
+        if (g.field == 1)
+          id = g.value;
+        else if (g.field == 4)
+          for (auto &h : readProto(g.bytes))
+            if (h.field == 1)
+              funcs.push_back(h.value);
+      }
+      locations[id] = funcs;
+    } else if (f.field == 5) {
+      uint64_t id = 0, name = 0, file = 0;
+      for (auto &g : readProto(f.bytes)) {
+        if (g.field == 1)
+          id = g.value;
+        else if (g.field == 2)
+          name = g.value;
+        else if (g.field == 4)
+          file = g.value;
+      }
+      ASSERT_LT(name, strings.size());
+      ASSERT_LT(file, strings.size());
+      functions[id] = {strings[name], strings[file]};
+    }
+  }
+
+  // samples have a stack and non-zero values
+  ASSERT_FALSE(samples.empty());
+  bool inProgram = false;
+  for (auto &sample : samples) {
+    vector<uint64_t> locs, values;
+    for (auto &f : readProto(sample.bytes)) {
+      if (f.field == 1)
+        locs = readPacked(f.bytes);
+      else if (f.field == 2)
+        values = readPacked(f.bytes);
+    }
+    EXPECT_FALSE(locs.empty());
+    ASSERT_EQ(values.size(), 2u);
+    EXPECT_GT(values[0], 0u);
+    EXPECT_GT(values[1], 0u);
+
+    // every location is symbolized, and some are in the program itself
+    for (auto loc : locs) {
+      ASSERT_TRUE(locations.count(loc));
+      EXPECT_FALSE(locations[loc].empty());
+      for (auto func : locations[loc]) {
+        ASSERT_TRUE(functions.count(func));
+        EXPECT_FALSE(functions[func].first.empty());
+        auto &file = functions[func].second;
+        if (file.size() >= source.size() &&
+            file.compare(file.size() - source.size(), source.size(), source) == 0)
+          inProgram = true;
+      }
+    }
+  }
+  EXPECT_TRUE(inProgram);
+}
+
+// Counts the instructions whose access groups (from the parallel_accesses
+// hints of @simd loops) are not all those of loops containing them
+static int countStrayAccessGroups(llvm::Module *M, int &parallelLoops) {
+  int stray = 0;
+  for (auto &F : *M) {
+    if (F.isDeclaration())
+      continue;
+    llvm::DominatorTree DT(F);
+    llvm::LoopInfo LI(DT);
+    std::unordered_map<const llvm::MDNode *, const llvm::Loop *> groupLoops;
+    for (auto *L : LI.getLoopsInPreorder()) {
+      auto *id = L->getLoopID();
+      if (!id)
+        continue;
+      for (unsigned i = 1; i < id->getNumOperands(); i++) {
+        auto *hint = llvm::dyn_cast<llvm::MDNode>(id->getOperand(i));
+        if (!hint || hint->getNumOperands() != 2)
+          continue;
+        auto *name = llvm::dyn_cast<llvm::MDString>(hint->getOperand(0));
+        if (name && name->getString() == "llvm.loop.parallel_accesses") {
+          groupLoops[llvm::cast<llvm::MDNode>(hint->getOperand(1))] = L;
+          ++parallelLoops;
+        }
+      }
+    }
+
+    for (auto &BB : F) {
+      for (auto &I : BB) {
+        auto *groups = I.getMetadata(llvm::LLVMContext::MD_access_group);
+        if (!groups)
+          continue;
+        // either a single group, or a list of them
+        std::vector<const llvm::MDNode *> list;
+        if (groups->getNumOperands() == 0)
+          list.push_back(groups);
+        for (auto &op : groups->operands())
+          list.push_back(llvm::cast<llvm::MDNode>(op));
+        for (auto *group : list) {
+          auto it = groupLoops.find(group);
+          if (it == groupLoops.end() || !it->second->contains(&BB))
+            ++stray;
+        }
+      }
+    }
+  }
+  return stray;
+}
+
+TEST(LoopHintsTest, AccessGroupsStayInLoop) {
+  // the raise and the code after the loop are not part of it
+  const string code = "def scale(x: List[float], y: List[float]):\n"
+                      "    @simd\n"
+                      "    for i in range(len(x)):\n"
+                      "        if x[i] < 0.0:\n"
+                      "            raise ValueError('negative')\n"
+                      "        y[i] = 2.0 * x[i]\n"
+                      "    y.append(0.0)\n"
+                      "x = [1.0, 2.0]\n"
+                      "y = [0.0, 0.0]\n"
+                      "scale(x, y)\n";
+
+  // compile in a child process, like the other tests
+  pid_t pid = fork();
+  GC_atfork_prepare();
+  ASSERT_NE(pid, -1);
+  if (pid == 0) {
+    GC_atfork_child();
+    auto compiler = std::make_unique<Compiler>(argv0, /*debug=*/false);
+    llvm::cantFail(compiler->parseCode("loop_hints.codon", code));
+    llvm::cantFail(compiler->compile());
+    int parallelLoops = 0;
+    int stray = countStrayAccessGroups(compiler->getLLVMVisitor()->getModule(),
+                                       parallelLoops);
+    if (parallelLoops == 0)
+      fprintf(stderr, "no parallel loops found\n");
+    if (stray)
+      fprintf(stderr, "%d access groups outside their loops\n", stray);
+    exit((parallelLoops > 0 && stray == 0) ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+  GC_atfork_parent();
+  int status = -1;
+  ASSERT_EQ(waitpid(pid, &status, 0), pid);
+  ASSERT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(WEXITSTATUS(status), 0);
+}
+
 auto getTypeTests(const vector<string> &files) {
   vector<tuple<string, bool, string, string, int, bool, bool>> cases;
   for (auto &f : files) {
@@ -475,6 +843,9 @@ INSTANTIATE_TEST_SUITE_P(
         "stdlib/sort_test.codon",
         "stdlib/heapq_test.codon",
         "stdlib/operator_test.codon",
+        "stdlib/gc_test.codon",
+        "stdlib/atomic_test.codon",
+        "stdlib/futures_test.codon",
         "python/pybridge.codon"
       ),
       testing::Values(true, false),
@@ -490,7 +861,9 @@ INSTANTIATE_TEST_SUITE_P(
     OptTests, SeqTest,
     testing::Combine(
         testing::Values(
+            "transform/auto_par.codon",
             "transform/canonical.codon",
+            "transform/devirtualize.codon",
             "transform/dict_opt.codon",
             "transform/escapes.codon",
             "transform/folding.codon",
@@ -500,6 +873,7 @@ INSTANTIATE_TEST_SUITE_P(
             "transform/list_opt.codon",
             "transform/omp.codon",
             "transform/outlining.codon",
+            "transform/pipeline_stages.codon",
             "transform/str_opt.codon"
         ),
         testing::Values(true, false),